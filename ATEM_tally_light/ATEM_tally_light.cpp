@@ -25,6 +25,7 @@
 #endif
 
 // #define DEBUG_LED_STRIP
+// #define DEBUG_LOOP_LATENCY
 #define FASTLED_ALLOW_INTERRUPTS 0
 
 #ifndef CHIP_FAMILY
@@ -53,6 +54,7 @@
 
 #include <EEPROM.h>
 #include <ATEMmin.h>
+#include <ATEMgroup.h>
 #include <TallyServer.h>
 #include <FastLED.h>
 
@@ -132,6 +134,15 @@ CRGB color_led[8] = { CRGB::Black, CRGB::Red, CRGB::Lime, CRGB::Blue, CRGB::Yell
 #define TALLY_FLAG_PROGRAM              1
 #define TALLY_FLAG_PREVIEW              2
 
+//Number of switchers a tally light can follow at once. The tally of them is combined: program if on program on any of them, and so on.
+//Changing it changes the layout of the settings in EEPROM. Switchers that are not set only take a pointer of RAM.
+#ifndef ATEM_SWITCHERS
+#define ATEM_SWITCHERS 2
+#endif
+#if ATEM_SWITCHERS > ATEM_maxGroupSwitchers
+#error "ATEM_SWITCHERS is more than an ATEMgroup can follow, raise ATEM_maxGroupSwitchers as well"
+#endif
+
 //Define Neopixel status-LED options
 #define NEOPIXEL_STATUS_FIRST           1
 #define NEOPIXEL_STATUS_LAST            2
@@ -162,7 +173,19 @@ ESP8266WebServer server(80);
 #endif
 
 #ifndef TALLY_TEST_SERVER
-ATEMmin atemSwitcher;
+ATEMmin *atemSwitchers[ATEM_SWITCHERS]; //Only created for the switchers that are set, in the order they are added to atemGroup
+
+//Reads the socket once for all switchers, and hands each datagram to the ATEMmin of the switcher that sent it
+ATEMgroup atemGroup;
+
+bool tallySubscribedToAll = true; //ATEMmin gets all tally flags from a tally server until subscribed to some
+
+//Commands from the switcher needed for tally and status. Everything else is skipped without parsing it.
+const uint32_t atemCommandFilter[] = { ATEM_fourCC('T', 'l', 'I', 'n'), ATEM_fourCC('S', 't', 'R', 'S'), ATEM_fourCC('_', 'p', 'i', 'n') };
+
+//Work done on switcher packets per loop, so a burst (like the initial state dump) doesn't hold up LEDs, web interface and tally server
+#define ATEM_LOOP_MAX_PACKETS 4
+#define ATEM_LOOP_MAX_MICROS 5000
 #else
 int tallyFlag = TALLY_FLAG_OFF;
 #endif
@@ -188,6 +211,9 @@ struct Settings {
     uint8_t neopixelStatusLEDOption;
     uint8_t neopixelBrightness;
     uint8_t ledBrightness;
+#if ATEM_SWITCHERS > 1
+    IPAddress extraSwitcherIPs[ATEM_SWITCHERS - 1]; //Switcher 2 and on. 0.0.0.0 (or 255.255.255.255 after upgrading from a version without them) for none
+#endif
 };
 
 Settings settings;
@@ -197,6 +223,12 @@ bool firstRun = true;
 int bytesAvailable = false;
 uint8_t readByte;
 
+#ifdef DEBUG_LOOP_LATENCY
+unsigned long loopStart;
+unsigned long loopTimeMax = 0;
+unsigned long loopTimeReported = 0;
+#endif
+
 //Commented out for users without batteries
 // long secLoop = 0;
 // int lowLedCount = 0;
@@ -243,6 +275,11 @@ void setup() {
     settings.tallySubnetMask = IPAddress(settings.tallySubnetMask[0], settings.tallySubnetMask[1], settings.tallySubnetMask[2], settings.tallySubnetMask[3]);
     settings.tallyGateway = IPAddress(settings.tallyGateway[0], settings.tallyGateway[1], settings.tallyGateway[2], settings.tallyGateway[3]);
     settings.switcherIP = IPAddress(settings.switcherIP[0], settings.switcherIP[1], settings.switcherIP[2], settings.switcherIP[3]);
+#if ATEM_SWITCHERS > 1
+    for (int i = 0; i < ATEM_SWITCHERS - 1; i++) {
+        settings.extraSwitcherIPs[i] = IPAddress(settings.extraSwitcherIPs[i][0], settings.extraSwitcherIPs[i][1], settings.extraSwitcherIPs[i][2], settings.extraSwitcherIPs[i][3]);
+    }
+#endif
 
     //Initialize LED strip
     if (0 < settings.neopixelsAmount && settings.neopixelsAmount <= 1000) {
@@ -305,6 +342,20 @@ void setup() {
 
     tallyServer.begin();
 
+#ifndef TALLY_TEST_SERVER
+    //Switcher 1 is always followed, the others if they are set
+    for (int i = 0; i < ATEM_SWITCHERS; i++) {
+        if (i == 0 || isSwitcherIPSet(getSwitcherIP(i))) {
+            ATEMmin *atemSwitcher = new ATEMmin();
+            atemSwitcher->setConnectionTimeouts(500, 1000); //Notice a lost switcher within a second, so the tally light doesn't keep showing stale tally
+            atemSwitcher->setFixedLocalPort(TALLY_SERVER_FAN_OUT_PORT); //Gets the fan-out if the "switcher" is another tally light
+            atemSwitchers[atemGroup.getCount()] = atemSwitcher;
+            atemGroup.add(*atemSwitcher);
+        }
+    }
+    updateTallySubscription(); //Before connecting, so it's told to a tally server in the hello
+#endif
+
     improv.setDeviceInfo(CHIP_FAMILY, DISPLAY_NAME, VERSION, "Tally Light", "");
     improv.onImprovError(onImprovWiFiErrorCb);
     improv.onImprovConnected(onImprovWiFiConnectedCb);
@@ -329,6 +380,10 @@ void setup() {
 }
 
 void loop() {
+#ifdef DEBUG_LOOP_LATENCY
+    loopStart = micros();
+#endif
+
     bytesAvailable = Serial.available();
     if(bytesAvailable > 0) {
         readByte = Serial.read();
@@ -344,6 +399,7 @@ void loop() {
                 Serial.println("IP:                  " + WiFi.localIP().toString());
                 Serial.println("Subnet Mask:         " + WiFi.subnetMask().toString());
                 Serial.println("Gateway IP:          " + WiFi.gatewayIP().toString());
+                tallyServer.setFanOut(WiFi.broadcastIP(), TALLY_SERVER_FAN_OUT_PORT); //Tally data to the tally lights connected to this one in one broadcast
 #ifdef TALLY_TEST_SERVER
                 Serial.println("Press enter (\\r) to loop through tally states.");
                 changeState(STATE_RUNNING);
@@ -363,15 +419,18 @@ void loop() {
         case STATE_CONNECTING_TO_SWITCHER:
             // Initialize a connection to the switcher:
             if (firstRun) {
-                atemSwitcher.begin(settings.switcherIP);
-                //atemSwitcher.serialOutput(0xff); //Makes Atem library print debug info
                 Serial.println("------------------------");
                 Serial.println("Connecting to switcher...");
-                Serial.println((String)"Switcher IP:         " + settings.switcherIP[0] + "." + settings.switcherIP[1] + "." + settings.switcherIP[2] + "." + settings.switcherIP[3]);
+                for (int i = 0; i < atemGroup.getCount(); i++) {
+                    IPAddress switcherIP = getSwitcherIP(i);
+                    atemSwitchers[i]->begin(switcherIP, atemCommandFilter, sizeof(atemCommandFilter) / sizeof(atemCommandFilter[0]));
+                    //atemSwitchers[i]->serialOutput(0xff); //Makes Atem library print debug info
+                    Serial.println((String)"Switcher IP:         " + switcherIP[0] + "." + switcherIP[1] + "." + switcherIP[2] + "." + switcherIP[3]);
+                }
                 firstRun = false;
             }
-            atemSwitcher.runLoop();
-            if (atemSwitcher.isConnected()) {
+            atemGroup.runLoop(0, 0);
+            if (isAnySwitcherConnected()) {
                 changeState(STATE_RUNNING);
                 Serial.println("Connected to switcher");
             }
@@ -407,13 +466,14 @@ void loop() {
                 }
             }
 #else
-            //Handle data exchange and connection to swithcher
-            atemSwitcher.runLoop();
+            //Handle data exchange and connection to swithchers
+            updateTallySubscription();
+            atemGroup.runLoop(ATEM_LOOP_MAX_PACKETS, ATEM_LOOP_MAX_MICROS);
 
-            int tallySources = atemSwitcher.getTallyByIndexSources();
+            int tallySources = getTallySources();
             tallyServer.setTallySources(tallySources);
             for (int i = 0; i < tallySources; i++) {
-                tallyServer.setTallyFlag(i, atemSwitcher.getTallyByIndexTallyFlags(i));
+                tallyServer.setTallyFlag(i, getTallyFlags(i));
             }
 #endif
 
@@ -429,8 +489,8 @@ void loop() {
             setLED2(color);
 
 #ifndef TALLY_TEST_SERVER
-            //Switch state if ATEM connection is lost...
-            if (!atemSwitcher.isConnected()) { // will return false if the connection was lost
+            //Switch state if the connection to all switchers is lost...
+            if (!isAnySwitcherConnected()) { // will return false if the connection was lost
                 Serial.println("------------------------");
                 Serial.println("Connection to Switcher lost...");
                 changeState(STATE_CONNECTING_TO_SWITCHER);
@@ -453,8 +513,10 @@ void loop() {
 
 #ifndef TALLY_TEST_SERVER
         //Force atem library to reset connection, in order for status to read correctly on website.
-        atemSwitcher.begin(settings.switcherIP);
-        atemSwitcher.connect();
+        for (int i = 0; i < atemGroup.getCount(); i++) {
+            atemSwitchers[i]->begin(getSwitcherIP(i), atemCommandFilter, sizeof(atemCommandFilter) / sizeof(atemCommandFilter[0]));
+            atemSwitchers[i]->connect();
+        }
 #endif
 
         //Reset tally server's tally flags, They won't get the message, but it'll be reset for when the connectoin is back.
@@ -472,6 +534,19 @@ void loop() {
 
     //Handle web interface
     server.handleClient();
+
+#ifdef DEBUG_LOOP_LATENCY
+    //Report the longest loop (worst case stall of LEDs, web interface and tally server) every 10 seconds
+    unsigned long loopTime = micros() - loopStart;
+    if (loopTime > loopTimeMax) {
+        loopTimeMax = loopTime;
+    }
+    if (millis() - loopTimeReported > 10000) {
+        Serial.println((String)"Max loop time:       " + loopTimeMax + " us");
+        loopTimeMax = 0;
+        loopTimeReported = millis();
+    }
+#endif
 }
 
 //Handle the change of states in the program
@@ -656,13 +731,77 @@ void printLeds() {
 }
 #endif
 
-int getTallyState(uint16_t tallyNo) {
 #ifndef TALLY_TEST_SERVER
-    if(tallyNo >= atemSwitcher.getTallyByIndexSources()) { //out of range
-        return TALLY_FLAG_OFF;
+//IP of switcher index (0 being switcher 1)
+IPAddress getSwitcherIP(int index) {
+#if ATEM_SWITCHERS > 1
+    if (index > 0) {
+        return settings.extraSwitcherIPs[index - 1];
+    }
+#endif
+    return settings.switcherIP;
+}
+
+bool isSwitcherIPSet(IPAddress ip) {
+    return ip != IPAddress(0, 0, 0, 0) && ip != IPAddress(255, 255, 255, 255);
+}
+
+bool isAnySwitcherConnected() {
+    for (int i = 0; i < atemGroup.getCount(); i++) {
+        if (atemSwitchers[i]->isConnected()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Highest number of tally sources of the connected switchers
+int getTallySources() {
+    int tallySources = 0;
+    for (int i = 0; i < atemGroup.getCount(); i++) {
+        if (atemSwitchers[i]->isConnected() && atemSwitchers[i]->getTallyByIndexSources() > tallySources) {
+            tallySources = atemSwitchers[i]->getTallyByIndexSources();
+        }
+    }
+    return tallySources;
+}
+
+//Tally flags of the connected switchers combined, so a source is on program (or preview) if it is on any of them
+uint8_t getTallyFlags(uint16_t tallyNo) {
+    uint8_t tallyFlags = TALLY_FLAG_OFF;
+    for (int i = 0; i < atemGroup.getCount(); i++) {
+        if (atemSwitchers[i]->isConnected() && tallyNo < atemSwitchers[i]->getTallyByIndexSources()) {
+            tallyFlags |= atemSwitchers[i]->getTallyByIndexTallyFlags(tallyNo);
+        }
+    }
+    return tallyFlags;
+}
+
+bool isAnySwitcherStreaming() {
+    for (int i = 0; i < atemGroup.getCount(); i++) {
+        if (atemSwitchers[i]->isConnected() && atemSwitchers[i]->getStreamStreaming()) {
+            return true;
+        }
     }
+    return false;
+}
 
-    uint8_t tallyFlag = atemSwitcher.getTallyByIndexTallyFlags(tallyNo);
+//Only the tally flags of this tally light are needed from a tally server, unless other tally lights get theirs from this one
+void updateTallySubscription() {
+    bool subscribeToAll = tallyServer.getClientCount() > 0;
+    if (subscribeToAll == tallySubscribedToAll) {
+        return;
+    }
+    for (int i = 0; i < atemGroup.getCount(); i++) {
+        atemSwitchers[i]->setTallySubscription(&settings.tallyNo, subscribeToAll ? 0 : 1);
+    }
+    tallySubscribedToAll = subscribeToAll;
+}
+#endif
+
+int getTallyState(uint16_t tallyNo) {
+#ifndef TALLY_TEST_SERVER
+    uint8_t tallyFlag = getTallyFlags(tallyNo);
 #endif
     if (tallyFlag & TALLY_FLAG_PROGRAM) {
         return TALLY_FLAG_PROGRAM;
@@ -676,7 +815,7 @@ int getTallyState(uint16_t tallyNo) {
 int getLedColor(int tallyMode, int tallyNo) {
     if(tallyMode == MODE_ON_AIR) {
 #ifndef TALLY_TEST_SERVER
-        if(atemSwitcher.getStreamStreaming()) {
+        if(isAnySwitcherStreaming()) {
             return LED_RED;
         }
 #endif
@@ -747,21 +886,25 @@ void handleRoot() {
     html += WiFi.gatewayIP().toString();
     html += "</td></tr><tr><td><br></td></tr>";
 #ifndef TALLY_TEST_SERVER
-    html += "<tr><td>ATEM switcher status:</td><td colspan=\"2\">";
-    // if (atemSwitcher.hasInitialized())
-    //     html += "Connected - Initialized";
-    // else
-    if (atemSwitcher.isRejected())
-        html += "Connection rejected - No empty spot";
-    else if (atemSwitcher.isConnected())
-        html += "Connected"; // - Wating for initialization";
-    else if (WiFi.status() == WL_CONNECTED)
-        html += "Disconnected - No response from switcher";
-    else
-        html += "Disconnected - Waiting for WiFi";
-    html += "</td></tr><tr><td>ATEM switcher IP:</td><td colspan=\"2\">";
-    html += (String)settings.switcherIP[0] + '.' + settings.switcherIP[1] + '.' + settings.switcherIP[2] + '.' + settings.switcherIP[3];
-    html += "</td></tr><tr><td><br></td></tr>";
+    for (int i = 0; i < atemGroup.getCount(); i++) {
+        String switcherName = i == 0 ? "ATEM switcher" : (String)"ATEM switcher " + (i + 1);
+        IPAddress switcherIP = getSwitcherIP(i);
+        html += "<tr><td>" + switcherName + " status:</td><td colspan=\"2\">";
+        // if (atemSwitchers[i]->hasInitialized())
+        //     html += "Connected - Initialized";
+        // else
+        if (atemSwitchers[i]->isRejected())
+            html += "Connection rejected - No empty spot";
+        else if (atemSwitchers[i]->isConnected())
+            html += "Connected"; // - Wating for initialization";
+        else if (WiFi.status() == WL_CONNECTED)
+            html += "Disconnected - No response from switcher";
+        else
+            html += "Disconnected - Waiting for WiFi";
+        html += "</td></tr><tr><td>" + switcherName + " IP:</td><td colspan=\"2\">";
+        html += (String)switcherIP[0] + '.' + switcherIP[1] + '.' + switcherIP[2] + '.' + switcherIP[3];
+        html += "</td></tr><tr><td><br></td></tr>";
+    }
 #endif
     html += "<tr bgcolor=\"#777777\"style=\"color:#ffffff;font-size:.8em;\"><td colspan=\"3\"><h2>&nbsp;Settings:</h2></td></tr><tr><td><br></td></tr><form action=\"/save\"method=\"post\"><tr><td>Tally Light name: </td><td><input type=\"text\"size=\"30\"maxlength=\"30\"name=\"tName\"value=\"";
 #ifdef ESP32
@@ -866,6 +1009,20 @@ void handleRoot() {
     html += "\"required/>. <input class=\"IP\"type=\"text\"size=\"3\"maxlength=\"3\"name=\"aIP4\"pattern=\"\\d{0,3}\"value=\"";
     html += settings.switcherIP[3];
     html += "\"required/></tr>";
+#if ATEM_SWITCHERS > 1
+    //Switcher 2 and on, named s<switcher>IP<octet>
+    for (int i = 0; i < ATEM_SWITCHERS - 1; i++) {
+        String name = (String)"s" + (i + 2) + "IP";
+        html += (String)"<tr><td>ATEM switcher " + (i + 2) + " IP: </td><td>";
+        for (int j = 0; j < 4; j++) {
+            html += (String)"<input class=\"IP\"type=\"text\"size=\"3\"maxlength=\"3\"name=\"" + name + (j + 1) + "\"pattern=\"\\d{0,3}\"value=\"";
+            html += settings.extraSwitcherIPs[i][j];
+            html += j < 3 ? "\"required/>. " : "\"required/>";
+        }
+        html += "</td></tr>";
+    }
+    html += "<tr><td/><td style=\"font-size:.8em;\">0.0.0.0 if not used. Tally is on if it is on any of the switchers.</td></tr>";
+#endif
 #endif
     html += "<tr><td><br></td></tr><tr><td/><td style=\"float: right;\"><input type=\"submit\"value=\"Save Changes\"/></td></tr></form><tr bgcolor=\"#cccccc\"style=\"font-size: .8em;\"><td colspan=\"3\"><p>&nbsp;&copy; 2020-2022 <a href=\"https://aronhetlam.github.io/\">Aron N. Het Lam</a></p><p>&nbsp;Based on ATEM libraries for Arduino by <a href=\"https://www.skaarhoj.com/\">SKAARHOJ</a></p></td></tr></table></body></html>";
     server.send(200, "text/html", html);
@@ -941,6 +1098,15 @@ void handleSave() {
             } else if (var == "aIP4") {
                 settings.switcherIP[3] = val.toInt();
             }
+#if ATEM_SWITCHERS > 1
+            else if (var.length() == 5 && var[0] == 's' && var.substring(2, 4) == "IP") { //s<switcher>IP<octet>, switcher 2 and on
+                int switcher = var[1] - '2';
+                int octet = var[4] - '1';
+                if (0 <= switcher && switcher < ATEM_SWITCHERS - 1 && 0 <= octet && octet < 4) {
+                    settings.extraSwitcherIPs[switcher][octet] = val.toInt();
+                }
+            }
+#endif
         }
 
         if (change) {
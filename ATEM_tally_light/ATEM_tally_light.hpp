@@ -49,6 +49,26 @@ void setStatusLED(uint8_t color);
 void printLeds();
 #endif
 
+#ifndef TALLY_TEST_SERVER
+//IP of switcher index (0 being switcher 1)
+IPAddress getSwitcherIP(int index);
+
+bool isSwitcherIPSet(IPAddress ip);
+
+bool isAnySwitcherConnected();
+
+//Highest number of tally sources of the connected switchers
+int getTallySources();
+
+//Tally flags of the connected switchers combined, so a source is on program (or preview) if it is on any of them
+uint8_t getTallyFlags(uint16_t tallyNo);
+
+bool isAnySwitcherStreaming();
+
+//Subscribes to the tally index of this tally light at switchers that are tally servers, or to all of them while other tally lights are connected to this one
+void updateTallySubscription();
+#endif
+
 int getTallyState(uint16_t tallyNo);
 
 int getLedColor(int tallyMode, int tallyNo);
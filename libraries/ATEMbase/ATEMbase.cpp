@@ -30,41 +30,111 @@ you can keep a clear conscience: http://skaarhoj.com/about/licenses/
 
 
 
+uint8_t ATEMbase::_receiveBuffer[ATEM_receiveBufferLength];
+
 /**
  * Constructor
  */
-ATEMbase::ATEMbase(){}
+ATEMbase::ATEMbase(){
+	_missedInitializationPackages = NULL;
+	_missedInitializationPackagesLength = 0;
+	_udpStarted = false;
+	_recorder = NULL;
+	_commandCache = NULL;
+	_tallyServerFeatures = 0;
+	memset(_tallySubscription, 0, ATEM_tallySubscriptionLength);
+	_isTallyServer = false;
+	_tallyStateWanted = false;
+	_tallyStateRequestedAt = 0;
+	_transport = &_defaultTransport;
+
+	// Options, kept across begin()
+	_commandFilter = NULL;
+	_commandFilterLength = 0;
+	_ackCoalescing = false;
+	_connectionTimeout = ATEM_connectionTimeout;
+	_probeInterval = ATEM_probeInterval;
+	_fixedLocalPort = 0;
+}
+
+/**
+ * Destructor
+ */
+ATEMbase::~ATEMbase(){
+	delete[] _missedInitializationPackages;
+}
 
 /**
  * Setting up IP address for the switcher (and local port to send packets from)
  * Using local port here is deprecated. Rather let the library pick a random one
+ * Resets the connection and the counters, but not the options set with setCommandFilter(), setAckCoalescing(), setConnectionTimeouts() and setFixedLocalPort()
  */
 void ATEMbase::begin(const IPAddress ip){
 	begin(ip, random(50100,65300));
 }
+/**
+ * Setting up IP address for the switcher, and only parse the given commands (see setCommandFilter())
+ */
+void ATEMbase::begin(const IPAddress ip, const uint32_t *commandFilter, const uint8_t commandFilterLength){
+	begin(ip);
+	setCommandFilter(commandFilter, commandFilterLength);
+}
 void ATEMbase::begin(const IPAddress ip, const uint16_t localPort){
 
 	neverConnected = true;
-	waitingForIncoming = false;
 
-		// Set up Udp communication object:
-	#if defined ESP8266 || defined ESP32
-	WiFiUDP Udp;
-	#else
-	EthernetUDP Udp;
-	#endif
+	if (_missedInitializationPackages == NULL)	{
+		_resizeMissedInitializationPackages(ATEM_maxInitPackageCount-1);
+	}
 
-	_Udp = Udp;
+		// Set up Udp communication object:
+	if (_udpStarted)	{
+		_transport->stop();
+		_udpStarted = false;
+	}
 	
 	_switcherIP = ip;			// Set switcher IP address
 	_localPort = localPort;		// Set default local port
 
 	_lastContact = 0;
 	_serialOutput = 0;
+
+	_replaying = false;
+	_parsedCommands = 0;
+	_skippedCommands = 0;
+	_reorderedPackets = 0;
+	_duplicatePackets = 0;
+	_skippedGaps = 0;
+	_latePackets = 0;
+	_fanOutPackets = 0;
+	_lastAckedPacketId = 0;
+	_lastAckLatency = 0;
+	_commandRetransmits = 0;
+	_commandsLost = 0;
+	_bundleSplits = 0;
+	_resendRequestsServed = 0;
+	_resendRequestsMissed = 0;
+	_initPackageRequestCount = 0;
+	_initDuration = 0;
+
+	_connectionPhase = ATEM_phaseIdle;
+	_reconnectBackoff = ATEM_reconnectBackoffMin;
+	_lostAt = 0;
+	_lastReconnectDuration = 0;
+	_reconnects = 0;
+	resetLatencyStats();
 	
 	resetCommandBundle();
 }
 
+/**
+ * Use transport for talking to the switcher instead of the UDP of the board, e.g. a PosixUdpTransport or one for testing.
+ * Call it before begin(). NULL goes back to the default.
+ */
+void ATEMbase::setTransport(UdpTransport *transport)	{
+	_transport = transport != NULL ? transport : &_defaultTransport;
+}
+
 /**
  * Initiating connection handshake to the ATEM switcher
  */
@@ -75,8 +145,12 @@ void ATEMbase::connect() {
 /**
  * Initiating connection handshake to the ATEM switcher
  * If useFixedPortNumber is true, the same port number will be used on subsequent connects, otherwise - and recommended - a new, random port number is used.
+ * The socket is kept when retrying a connection attempt the switcher didn't answer. It's only replaced (closing the old one) after a session with the switcher.
+ * With a fixed port (also see setFixedLocalPort()) it's kept after a session as well, and the hello has a random temporary session ID instead,
+ * so the switcher doesn't take it for the old session.
  */
 void ATEMbase::connect(const boolean useFixedPortNumber) {
+	neverConnected = false;			// Also when called from the sketch, so runLoop() doesn't connect again
 	_localPacketIdCounter = 0;		// Init localPacketIDCounter to 0;
 	_initPayloadSent = false;		// Will be true after initial payload of data is delivered (regular 12-byte ping packages are transmitted.)
 	_hasInitialized = false;		// Will be true after initial payload of data is resent and received well
@@ -84,11 +158,50 @@ void ATEMbase::connect(const boolean useFixedPortNumber) {
 	_isRejected = false;			// Will be true if the connection was rejected during hello-package handshakes.
 	_sessionID = 0x53AB;			// Temporary session ID - a new will be given back from ATEM.
 	_lastContact = millis();  		// Setting this, because even though we haven't had contact, it constitutes an attempt that should be responded to at least
-	memset(_missedInitializationPackages, 0xFF, (ATEM_maxInitPackageCount+7)/8);
-	_initPayloadSentAtPacketId = ATEM_maxInitPackageCount;	// The max value it can be
-	uint16_t portNumber = useFixedPortNumber ? _localPort : random(50100,65300);
-
-	_Udp.begin(portNumber);		
+	_connectedAt = _lastContact;
+	_initDuration = 0;
+	if (_missedInitializationPackages != NULL)	{
+		memset(_missedInitializationPackages, 0xFF, _missedInitializationPackagesLength);
+	}
+	if (_commandCache != NULL)	{	// The new session starts with the whole state again
+		_commandCache->clear();
+	}
+	_initPayloadSentAtPacketId = ATEM_maxInitPackageCount;	// Until we know better
+	for (uint8_t i = 0; i < ATEM_initRecoveryDepth; i++) _initPackageRequests[i]._packetId = 0;
+	_ackPending = false;
+	_remoteContiguousPacketId = 0;
+	_remoteAppliedAhead = 0;
+	_remoteNextPacketId = 0;
+	for (uint8_t i = 0; i < ATEM_reorderWindow; i++) _heldPackets[i]._length = 0;
+	_skippedPacketRequestedAt = 0;
+	_fanOutSequence = 0;
+	_isTallyServer = false;
+	_tallyStateWanted = false;
+	_tallyStateRequestedAt = 0;
+	_ackRequests = 0;
+	_acksSent = 0;
+	for (uint8_t i = 0; i < ATEM_outgoingWindowSize; i++)	{
+		_commandPackets[i]._inFlight = false;
+		_commandPackets[i]._length = 0;	// Not in the history
+	}
+	_srtt8 = 0;
+	_rttvar4 = 0;
+	_retransmitTimeout = ATEM_initialRetransmitTimeout;
+	_lastProbeAt = _lastContact;
+	_setConnectionPhase(ATEM_phaseConnecting);
+
+	bool fixedPort = useFixedPortNumber || _fixedLocalPort != 0;
+	if (!_udpStarted || (_udpHadSession && !fixedPort))	{
+		if (_udpStarted)	{
+			_transport->stop();
+		}
+		_udpPort = _fixedLocalPort != 0 ? _fixedLocalPort : (useFixedPortNumber ? _localPort : random(50100,65300));
+		_transport->begin(_udpPort);
+		_udpStarted = true;
+		_udpHadSession = false;
+	} else if (_udpHadSession)	{	// Reconnecting from the port of the last session
+		_sessionID = random(1, 0x8000);
+	}
 
 		
 	// Send connectString to ATEM:
@@ -96,7 +209,7 @@ void ATEMbase::connect(const boolean useFixedPortNumber) {
   		Serial.print(F("Sending connect packet to ATEM switcher on IP "));
 		Serial.print(_switcherIP);
 		Serial.print(F(" from port "));
-		Serial.println(portNumber);
+		Serial.println(_udpPort);
 	}
 
 	
@@ -126,175 +239,338 @@ void ATEMbase::runLoop(uint16_t delayTime) {
 	unsigned long enterTime = millis();
 
 	do {
-		while(true) {	// Iterate until UDP buffer is empty
-			uint16_t packetSize = _Udp.parsePacket();
-			if (_Udp.available())   {  	
-				_Udp.read(_packetBuffer,12);	// Read header
-				 _sessionID = word(_packetBuffer[2], _packetBuffer[3]);
-				 uint8_t headerBitmask = _packetBuffer[0]>>3;
-				 _lastRemotePacketID = word(_packetBuffer[10],_packetBuffer[11]);
-			 	 if (_lastRemotePacketID < ATEM_maxInitPackageCount)	{
-			 	 	_missedInitializationPackages[_lastRemotePacketID>>3] &= ~(B1<<(_lastRemotePacketID&0x07));
-			 	 }
-
-				 uint16_t packetLength = word(_packetBuffer[0] & B00000111, _packetBuffer[1]);
-
-			    if (packetSize==packetLength) {  // Just to make sure these are equal, they should be!
-					_lastContact = millis();
-					waitingForIncoming = false;
-	
-					if (headerBitmask & ATEM_headerCmd_HelloPacket)	{	// Respond to "Hello" packages:
-						_isConnected = true;
-					
-						_Udp.read(_packetBuffer, 1); // Read 13th byte to get hello packet type.
-						_isRejected = _packetBuffer[0] == 3; // _packetBuffer[12]	The ATEM will return a "2" in this return package of same length. If the ATEM returns "3" it means "fully booked" (no more clients can connect) and a "4" seems to be a kind of reconnect (seen when you drop the connection and the ATEM desperately tries to figure out what happened...)
-						// _packetBuffer[15]	This number seems to increment with about 3 each time a new client tries to connect to ATEM. It may be used to judge how many client connections has been made during the up-time of the switcher?
-						
-						_wipeCleanPacketBuffer();
-						_createCommandHeader(ATEM_headerCmd_Ack, 12);
-						_packetBuffer[9] = 0x03;	// This seems to be what the client should send upon first request. 
-						_sendPacketBuffer(12);  
-					}
-
-					// If a packet is 12 bytes long it indicates that all the initial information 
-					// has been delivered from the ATEM and we can begin to answer back on every request
-					// Currently we don't know any other way to decide if an answer should be sent back...
-					// The QT lib uses the "InCm" command to indicate this, but in the latest version of the firmware (2.14)
-					// all the camera control information comes AFTER this command, so it's not a clear ending token anymore.
-					// However, I'm not sure if I checked the _lastRemotePacketID of the packages with the additional camera control info - if it was a resend, 
-					// "InCm" may still indicate the number of the last init-package and that's all I need to request the missing ones....
-			
-					// BTW: It has been observed on an old 10Mbit hub that packages could arrive in a different order than sent and this may 
-					// mess things up a bit on the initialization. So it's recommended to has as direct routes as possible.
-					if(!_initPayloadSent && packetSize == 12 && _lastRemotePacketID>1) {
-						_initPayloadSent = true;
-						_initPayloadSentAtPacketId = _lastRemotePacketID;
-						#if ATEM_debug 
-						if (_serialOutput & 0x80) {
-							Serial.print(F("_initPayloadSent=TRUE @rpID "));
-							Serial.println(_initPayloadSentAtPacketId);
-							Serial.print(F("Session ID: "));
-							Serial.println(_sessionID, DEC);
-						}
-						#endif
-					} 
-
-					if ((headerBitmask & ATEM_headerCmd_AckRequest) && !(headerBitmask & ATEM_headerCmd_Resend)) { 	// Respond to request for acknowledge	(and to resends also, whatever...  
-						_wipeCleanPacketBuffer();
-						_createCommandHeader(ATEM_headerCmd_Ack, 12, _lastRemotePacketID);
-						_sendPacketBuffer(12); 
-					
-						#if ATEM_debug 
-				        if (_serialOutput & 0x80) {
-							Serial.print(F("rpID: "));
-				        	Serial.print(_lastRemotePacketID, DEC);
-							Serial.print(F(", Head: 0x"));
-							Serial.print(headerBitmask, HEX);
-							Serial.print(F(", Len: "));
-				        	Serial.print(packetLength, DEC);
-							Serial.print(F(" bytes"));
-
-							Serial.println(F(" - ACK!"));
-						} else 
-						#endif
-						if (_serialOutput>1)	{
-							Serial.print(F("rpID: "));
-				        	Serial.print(_lastRemotePacketID, DEC);
-							Serial.println(F(" - ACK!"));
-						} 
-					} else if((headerBitmask & ATEM_headerCmd_RequestNextAfter)) {	// ATEM is requesting a previously sent package which must have dropped out of the order. We return an empty one so the ATEM doesnt' crash (which some models will, if it doesn't get an answer before another 63 commands gets sent from the controller.)
-						uint8_t b1 = _packetBuffer[6];
-						uint8_t b2 = _packetBuffer[7];
-						_wipeCleanPacketBuffer();
-						_createCommandHeader(ATEM_headerCmd_Ack, 12, 0);
-						_packetBuffer[0] = ATEM_headerCmd_AckRequest << 3;	// Overruling this. A small trick because createCommandHeader shouldn't increment local package ID counter
-						_packetBuffer[10] = b1;
-						_packetBuffer[11] = b2;
-						_sendPacketBuffer(12); 
-
-						if (_serialOutput>1)	{
-							Serial.print(F("ATEM asking to resend "));
-				        	Serial.println((b1<<8)|b2, DEC);
-						}
-					} else {
-						#if ATEM_debug 
-				        if (_serialOutput & 0x80) {
-							Serial.print(F("rpID: "));
-				        	Serial.print(_lastRemotePacketID, DEC);
-							Serial.print(F(", Head: 0x"));
-							Serial.print(headerBitmask, HEX);
-							Serial.print(F(", Len: "));
-				        	Serial.print(packetLength, DEC);
-							Serial.println(F(" bytes"));
-						} else 
-						#endif
-						if (_serialOutput>1)	{
-							Serial.print(F("rpID: "));
-				        	Serial.println(_lastRemotePacketID, DEC);
-						}
-					}
-				
-					if (!(headerBitmask & ATEM_headerCmd_HelloPacket) && packetLength>12)	{
-						_parsePacket(packetLength);
-					}
-			    } else {
-					#if ATEM_debug
-					if (_serialOutput & 0x80) 	{
-			      		Serial.print(F("ERROR: Packet size mismatch: "));
-					    Serial.print(packetSize, DEC);
-					    Serial.print(F(" != "));
-					    Serial.println(packetLength, DEC);
-					}
-					#endif
-					// Flushing:
-			        while(_Udp.available()) {
-			        	_Udp.read(_packetBuffer, ATEM_packetBufferLength);
-			        }
-			    }
-			} else break;
+		while(_receiveDatagram()) {}	// Iterate until UDP buffer is empty
+		_runConnectionTasks();
+	} while (delayTime>0 && !hasTimedOut(enterTime,delayTime));
+
+	_checkConnectionTimeout();
+}
+
+/**
+ * Like runLoop(), but with a budget for the work done in one call, so a burst of packets from the switcher can't hold up the rest of the sketch.
+ * At most maxPackets datagrams are handled, and no new one is read after maxMicros microseconds. 0 means no limit.
+ * Whatever is left in the UDP buffer is handled on the next call. Acknowledges, retransmits and the connection timeout are taken care of on every call.
+ */
+ATEMrunLoopResult ATEMbase::runLoopBounded(uint16_t maxPackets, unsigned long maxMicros) {
+	if (neverConnected)	{
+		neverConnected = false;
+		connect();
+	}
+
+	ATEMrunLoopResult result = {0, false};
+	unsigned long enterTime = micros();
+
+	while(true) {
+		if ((maxPackets > 0 && result.packetsProcessed >= maxPackets) || (maxMicros > 0 && (unsigned long)(micros() - enterTime) >= maxMicros))	{
+			result.morePending = true;	// The UDP buffer can't be peeked, so there may be more
+			break;
+		}
+		if (!_receiveDatagram()) break;
+		result.packetsProcessed++;
+	}
+	_runConnectionTasks();
+
+	_checkConnectionTimeout();
+	return result;
+}
+
+/**
+ * Reads the next datagram from the switcher and handles it. Returns false if the UDP buffer was empty.
+ */
+bool ATEMbase::_receiveDatagram() {
+	uint16_t packetSize = _transport->parsePacket();
+	if (!_transport->available())	{
+		return false;
+	}
+	unsigned long receivedAt = micros();
+
+	// Read the whole datagram in one go. Header and commands are parsed in place from _receiveBuffer afterwards.
+	int readLength = _transport->read(_receiveBuffer, packetSize <= ATEM_receiveBufferLength ? packetSize : ATEM_receiveBufferLength);
+	if (readLength > 0 && (_receiveBuffer[0]>>3) == 0 && !(_transport->remoteIP() == _switcherIP))	{	// A fan-out from another tally server on the network
+		return true;
+	}
+	if (readLength > 0)	{
+		_handleDatagram(packetSize, readLength, receivedAt);
+	}
+	return true;
+}
+
+/**
+ * Records, processes and measures a datagram, which has been read into _receiveBuffer
+ */
+void ATEMbase::_handleDatagram(uint16_t packetSize, uint16_t readLength, unsigned long receivedAt) {
+	if (_recorder != NULL)	{
+		_recorder->record(ATEM_captureIn, receivedAt, _receiveBuffer, readLength);
+	}
+	if (readLength >= 12)	{	// Otherwise not even a full header, nothing to do with it.
+		_processDatagram(packetSize, readLength);
+		_addToHistogram(&_latencyStats.processing, micros() - receivedAt);
+	}
+}
+
+/**
+ * Handles a datagram as if it was received from the switcher, followed by the work runLoop() does after reading.
+ * The first call starts a session without a switcher, and nothing is sent on the network until begin() is called again
+ * (a recorder still gets what would have been sent). Used by ATEMreplay to feed recorded sessions through the client.
+ */
+void ATEMbase::replayDatagram(const uint8_t *data, uint16_t length) {
+	if (!_replaying)	{
+		_replaying = true;
+		neverConnected = false;
+		connect();
+	}
+
+	uint16_t readLength = length <= ATEM_receiveBufferLength ? length : ATEM_receiveBufferLength;
+	memcpy(_receiveBuffer, data, readLength);
+	_handleDatagram(length, readLength, micros());
+	_runConnectionTasks();
+}
+
+/**
+ * Records everything sent to the switcher to the recorder, or NULL to stop recording. See ATEMcapture.h
+ */
+void ATEMbase::setRecorder(ATEMrecorder *recorder) {
+	_recorder = recorder;
+}
+
+/**
+ * Handles a datagram from the switcher, which has been read into _receiveBuffer
+ */
+void ATEMbase::_processDatagram(uint16_t packetSize, uint16_t readLength) {
+	uint8_t headerBitmask = _receiveBuffer[0]>>3;
+	if (headerBitmask == 0)	{	// Switchers always set a flag, only a TallyServer fan-out has none
+		_handleFanOut(packetSize, readLength);
+		return;
+	}
+	_sessionID = word(_receiveBuffer[2], _receiveBuffer[3]);
+	_lastRemotePacketID = word(_receiveBuffer[10],_receiveBuffer[11]);
+	bool duplicate = false;		// An initialization package received before
+	if (!_hasInitialized && (!_initPayloadSent || _lastRemotePacketID <= _initPayloadSentAtPacketId) && (_lastRemotePacketID < _missedInitializationPackagesLength*8 || (!_initPayloadSent && _resizeMissedInitializationPackages(_lastRemotePacketID))))	{	// Not the live updates after the initialization
+		duplicate = (headerBitmask & ATEM_headerCmd_AckRequest) && !_isInitializationPackageMissed(_lastRemotePacketID);
+		_missedInitializationPackages[_lastRemotePacketID>>3] &= ~(B1<<(_lastRemotePacketID&0x07));
+		while ((!_initPayloadSent || _remoteContiguousPacketId < _initPayloadSentAtPacketId) && _remoteContiguousPacketId+1 < _missedInitializationPackagesLength*8 && !_isInitializationPackageMissed(_remoteContiguousPacketId+1))	{	// Initialization packages are parsed as they come, so received is applied
+			_remoteContiguousPacketId++;
+		}
+	}
+
+	uint16_t packetLength = word(_receiveBuffer[0] & B00000111, _receiveBuffer[1]);
+
+	if (packetSize==packetLength) {  // Just to make sure these are equal, they should be!
+		_lastContact = millis();
+
+		if (headerBitmask & ATEM_headerCmd_Ack)	{	// The ATEM acknowledges command packets we have sent
+			_handleAck(word(_receiveBuffer[4], _receiveBuffer[5]));
 		}
 
-		// After initialization, we check which packages were missed and ask for them:
-		if (!_hasInitialized && _initPayloadSent && !waitingForIncoming)	{
-			for(uint8_t i=1; i<_initPayloadSentAtPacketId; i++)	{
-				if(i <= ATEM_maxInitPackageCount) {
-					if (_missedInitializationPackages[i>>3] & (B1<<(i & 0x7)))	{
-
-						#if ATEM_debug
-						if (_serialOutput & 0x80) 	{
-				      		Serial.print(F("Asking for package "));
-						    Serial.println(i, DEC);
-						}
-						#endif
-						_wipeCleanPacketBuffer();
-						_createCommandHeader(ATEM_headerCmd_RequestNextAfter, 12);
-					    _packetBuffer[6] = highByte(i-1);  // Resend Packet ID, MSB
-					    _packetBuffer[7] = lowByte(i-1);  // Resend Packet ID, LSB
-					    _packetBuffer[8] = 0x01;
-					
-						_sendPacketBuffer(12);  
-						waitingForIncoming = true;
-						break;
-					}
-				} else {
-					break;
+		if (headerBitmask & ATEM_headerCmd_HelloPacket)	{	// Respond to "Hello" packages:
+			_isConnected = true;
+			_udpHadSession = true;
+		
+			_isRejected = readLength > 12 && _receiveBuffer[12] == 3; // _receiveBuffer[12]	The ATEM will return a "2" in this return package of same length. If the ATEM returns "3" it means "fully booked" (no more clients can connect) and a "4" seems to be a kind of reconnect (seen when you drop the connection and the ATEM desperately tries to figure out what happened...)
+			// _packetBuffer[15]	This number seems to increment with about 3 each time a new client tries to connect to ATEM. It may be used to judge how many client connections has been made during the up-time of the switcher?
+			if (!_isRejected)	{
+				_reconnectBackoff = ATEM_reconnectBackoffMin;
+				if (_connectionPhase == ATEM_phaseConnecting)	{
+					_setConnectionPhase(ATEM_phaseInitializing);
 				}
 			}
-			if (!waitingForIncoming)	{
-				_hasInitialized = true;
-				if (_serialOutput) {
-					Serial.println(F("ATEM _hasInitialized = TRUE"));
-				}
+			
+			_wipeCleanPacketBuffer();
+			_isTallyServer = readLength >= 20 && _receiveBuffer[16] == 'T' && _receiveBuffer[17] == 'S';	// A TallyServer marks its hello. Switchers are never sent the extension
+			if (_isTallyServer)	{
+				_createCommandHeader(ATEM_headerCmd_Ack, 12+8);
+				_packetBuffer[9] = 0x03;
+				_packetBuffer[12] = _tallyServerFeatures;	// Hello extension
+				memcpy(_packetBuffer+13, _tallySubscription, ATEM_tallySubscriptionLength);
+				_sendPacketBuffer(12+8);
+			} else {
+				_createCommandHeader(ATEM_headerCmd_Ack, 12);
+				_packetBuffer[9] = 0x03;	// This seems to be what the client should send upon first request. 
+				_sendPacketBuffer(12);  
+			}
+		}
+
+		// If a packet is 12 bytes long it indicates that all the initial information 
+		// has been delivered from the ATEM and we can begin to answer back on every request
+		// Currently we don't know any other way to decide if an answer should be sent back...
+		// The QT lib uses the "InCm" command to indicate this, but in the latest version of the firmware (2.14)
+		// all the camera control information comes AFTER this command, so it's not a clear ending token anymore.
+		// However, I'm not sure if I checked the _lastRemotePacketID of the packages with the additional camera control info - if it was a resend, 
+		// "InCm" may still indicate the number of the last init-package and that's all I need to request the missing ones....
+
+		// BTW: It has been observed on an old 10Mbit hub that packages could arrive in a different order than sent and this may 
+		// mess things up a bit on the initialization. So it's recommended to has as direct routes as possible.
+		if(!_initPayloadSent && packetSize == 12 && _lastRemotePacketID>1) {
+			_initPayloadSent = true;
+			_initPayloadSentAtPacketId = _lastRemotePacketID;
+			#if ATEM_debug 
+			if (_serialOutput & 0x80) {
+				Serial.print(F("_initPayloadSent=TRUE @rpID "));
+				Serial.println(_initPayloadSentAtPacketId);
+				Serial.print(F("Session ID: "));
+				Serial.println(_sessionID, DEC);
+			}
+			#endif
+		} 
+
+		if (headerBitmask & ATEM_headerCmd_AckRequest) { 	// Respond to request for acknowledge, also of resent packets
+			_ackRequests++;
+		
+			#if ATEM_debug 
+			if (_serialOutput & 0x80) {
+				Serial.print(F("rpID: "));
+				Serial.print(_lastRemotePacketID, DEC);
+				Serial.print(F(", Head: 0x"));
+				Serial.print(headerBitmask, HEX);
+				Serial.print(F(", Len: "));
+				Serial.print(packetLength, DEC);
+				Serial.print(F(" bytes"));
+
+				Serial.println(F(" - ACK!"));
+			} else 
+			#endif
+			if (_serialOutput>1)	{
+				Serial.print(F("rpID: "));
+				Serial.print(_lastRemotePacketID, DEC);
+				Serial.println(F(" - ACK!"));
+			} 
+		} else if((headerBitmask & ATEM_headerCmd_RequestNextAfter)) {	// ATEM is requesting a previously sent package which must have dropped out of the order. We resend it (and the ones sent after it) from the command packet history.
+			uint8_t b1 = _receiveBuffer[6];
+			uint8_t b2 = _receiveBuffer[7];
+
+			if (_resendCommandPacketsFrom(word(b1, b2)))	{
+				_resendRequestsServed++;
+			} else {	// Not in the history anymore. We return an empty one so the ATEM doesnt' crash (which some models will, if it doesn't get an answer before another 63 commands gets sent from the controller.)
+				_resendRequestsMissed++;
+				_wipeCleanPacketBuffer();
+				_createCommandHeader(ATEM_headerCmd_Ack, 12, 0);
+				_packetBuffer[0] = ATEM_headerCmd_AckRequest << 3;	// Overruling this. A small trick because createCommandHeader shouldn't increment local package ID counter
+				_packetBuffer[10] = b1;
+				_packetBuffer[11] = b2;
+				_sendPacketBuffer(12); 
+			}
+
+			if (_serialOutput>1)	{
+				Serial.print(F("ATEM asking to resend "));
+				Serial.println((b1<<8)|b2, DEC);
+			}
+		} else {
+			#if ATEM_debug 
+			if (_serialOutput & 0x80) {
+				Serial.print(F("rpID: "));
+				Serial.print(_lastRemotePacketID, DEC);
+				Serial.print(F(", Head: 0x"));
+				Serial.print(headerBitmask, HEX);
+				Serial.print(F(", Len: "));
+				Serial.print(packetLength, DEC);
+				Serial.println(F(" bytes"));
+			} else 
+			#endif
+			if (_serialOutput>1)	{
+				Serial.print(F("rpID: "));
+				Serial.println(_lastRemotePacketID, DEC);
 			}
 		}
-	} while (delayTime>0 && !hasTimedOut(enterTime,delayTime));
 	
+		if (!(headerBitmask & ATEM_headerCmd_HelloPacket))	{
+			_sequencePacket(headerBitmask, readLength, duplicate);
+			if (headerBitmask & ATEM_headerCmd_AckRequest)	{	// Acks are cumulative, so a packet after a missing one isn't acknowledged until that's parsed, even if the missing one was given up on
+				if (_ackCoalescing) _ackPending = true;		// Acknowledged after the UDP buffer is drained
+				else _sendAck(_remoteContiguousPacketId);
+			}
+		}
+	} else {
+		#if ATEM_debug
+		if (_serialOutput & 0x80) 	{
+			Serial.print(F("ERROR: Packet size mismatch: "));
+			Serial.print(packetSize, DEC);
+			Serial.print(F(" != "));
+				Serial.println(packetLength, DEC);
+		}
+		#endif
+	}
+}
+
+/**
+* Work to be done after reading from the switcher: Acknowledges, retransmits and requests for missed initialization packages
+*/
+void ATEMbase::_runConnectionTasks() {
+	if (_ackPending)	{	// One acknowledge for everything parsed in one go
+		_sendAck(_remoteContiguousPacketId);
+		_ackPending = false;
+	}
+
+	_retransmitCommandPackets();
+
+	if (_hasInitialized)	{
+		_releaseHeldPackets();
+		_requestSkippedPacket();
+	}
+
+	if (_tallyStateWanted && _isTallyServer && _hasInitialized && !_cBundle)	{	// Not while the user is building a command bundle
+		if (_tallyStateRequestedAt == 0 || hasTimedOut(_tallyStateRequestedAt, ATEM_tallyStateRequestInterval))	{
+			_requestTallyState();
+		}
+	}
+
+	// After initialization, we check which packages were missed and ask for them:
+	if (!_hasInitialized && _initPayloadSent)	{
+		_requestMissedInitializationPackages();
+	}
+}
 
-    // If connection is gone anyway, try to reconnect:
-	if (hasTimedOut(_lastContact, 5000))	{
-      if (_serialOutput) Serial.println(F("Connection to ATEM Switcher has timed out - reconnecting!"));
-      connect();
-    }	
+/**
+ * Asks a TallyServer for the whole tally state, which it answers with a stamped TlIn (Added by Aron N. Het Lam)
+ * Sent from _runConnectionTasks() rather than while parsing the delta that was missed, and again every
+ * ATEM_tallyStateRequestInterval until the state arrives, as a TlRq given up on after ATEM_maxRetransmits is never answered.
+ */
+void ATEMbase::_requestTallyState() {
+	_prepareCommandPacket(PSTR("TlRq"),4);
+	_finishCommandPacket();
+
+	_tallyStateRequestedAt = millis();
+}
+
+/**
+ * Probes the switcher when it has been silent for a while, and if the connection is gone anyway, tries to reconnect.
+ * Reconnect attempts are spaced by an exponential backoff with jitter, so a number of clients don't all hit a rebooting switcher at once.
+ */
+void ATEMbase::_checkConnectionTimeout() {
+	if (_connectionPhase == ATEM_phaseReconnectWait)	{
+		if (hasTimedOut(_reconnectWaitStartedAt, _reconnectWait))	{
+			connect();
+		}
+		return;
+	}
+
+	if (hasTimedOut(_lastContact, _connectionTimeout))	{
+		if (_serialOutput) Serial.println(F("Connection to ATEM Switcher has timed out - reconnecting!"));
+		if (_lostAt == 0 && _connectionPhase != ATEM_phaseConnecting)	{
+			_lostAt = _lastContact;
+		}
+		_isConnected = false;
+		_reconnectWait = random(_reconnectBackoff/2, _reconnectBackoff+1);
+		_reconnectBackoff = _reconnectBackoff < ATEM_reconnectBackoffMax/2 ? _reconnectBackoff*2 : ATEM_reconnectBackoffMax;
+		_reconnectWaitStartedAt = millis();
+		_setConnectionPhase(ATEM_phaseReconnectWait);
+		return;
+	}
+
+	if ((_connectionPhase == ATEM_phaseInitializing || _connectionPhase == ATEM_phaseConnected) && !_cBundle && hasTimedOut(_lastContact, _probeInterval) && hasTimedOut(_lastProbeAt, _probeInterval))	{
+		// An empty packet asking for an acknowledge. The answer counts as contact
+		_wipeCleanPacketBuffer();
+		_sendCommandPacket(12);
+		_lastProbeAt = millis();
+	}
+}
+
+void ATEMbase::_setConnectionPhase(uint8_t phase) {
+	if (phase == ATEM_phaseConnected && _lostAt != 0)	{
+		_lastReconnectDuration = millis() - _lostAt;
+		_lostAt = 0;
+		_reconnects++;
+	}
+	_connectionPhase = phase;
 }
 
 /**
@@ -332,6 +608,90 @@ bool ATEMbase::isRejected() {
 	return _isRejected;
 }
 
+/**
+ * Only hand the commands in commandFilter (made with ATEM_fourCC) to _parseGetCommands(). All other commands
+ * are skipped by their length without being parsed. Passing NULL (or a length of 0) parses all commands again.
+ * The array is not copied, so it must stay valid - preferably make it a static const.
+ */
+void ATEMbase::setCommandFilter(const uint32_t *commandFilter, const uint8_t commandFilterLength) {
+	_commandFilter = commandFilterLength > 0 ? commandFilter : NULL;
+	_commandFilterLength = commandFilterLength;
+}
+
+/**
+ * Keeps the payload of every command received in commandCache, also of commands skipped by the command filter,
+ * so any state of the switcher can be read from it. NULL stops it. See ATEMcommandCache.h
+ */
+void ATEMbase::setCommandCache(ATEMcommandCache *commandCache) {
+	_commandCache = commandCache;
+}
+
+/**
+ * If enabled, packets from the ATEM are not acknowledged one by one. Instead all datagrams waiting in the UDP buffer are
+ * handled first, and then the highest packet ID up to which everything has been received is acknowledged once.
+ * This saves a lot of acknowledges during the initialization. Since it happens within the same runLoop() call,
+ * the ATEM gets its acknowledge well before it would resend.
+ */
+void ATEMbase::setAckCoalescing(bool enable) {
+	_ackCoalescing = enable;
+}
+
+/**
+ * Number of acknowledges saved by setAckCoalescing() in this session
+ */
+unsigned long ATEMbase::getAcksSavedCount() {
+	return _ackRequests > _acksSent ? _ackRequests - _acksSent : 0;
+}
+
+/**
+ * Number of commands parsed since begin()
+ */
+unsigned long ATEMbase::getParsedCommandCount() {
+	return _parsedCommands;
+}
+
+/**
+ * Number of commands skipped by the command filter since begin()
+ */
+unsigned long ATEMbase::getSkippedCommandCount() {
+	return _skippedCommands;
+}
+
+/**
+ * Number of packets from the switcher held back since begin(), because they arrived ahead of one that was missing
+ */
+unsigned long ATEMbase::getReorderedPacketCount() {
+	return _reorderedPackets;
+}
+
+/**
+ * Number of packets from the switcher dropped since begin() without being parsed, because they were parsed already
+ */
+unsigned long ATEMbase::getDuplicatePacketCount() {
+	return _duplicatePackets;
+}
+
+/**
+ * Number of times since begin() that packets missing from the switcher were given up on, applying the held back ones after them
+ */
+unsigned long ATEMbase::getSkippedGapCount() {
+	return _skippedGaps;
+}
+
+/**
+ * Number of packets from the switcher parsed since begin() after they had been given up on, arriving late
+ */
+unsigned long ATEMbase::getLatePacketCount() {
+	return _latePackets;
+}
+
+/**
+ * Number of fan-out datagrams from a TallyServer parsed since begin(), see _handleFanOut()
+ */
+unsigned long ATEMbase::getFanOutPacketCount() {
+	return _fanOutPackets;
+}
+
 
 
 
@@ -366,10 +726,18 @@ void ATEMbase::_createCommandHeader(const uint8_t headerCmd, const uint16_t leng
 	    _packetBuffer[11] = lowByte(_localPacketIdCounter);  // Local Packet ID, LSB
     }
 }
-void ATEMbase::_sendPacketBuffer(uint8_t length)	{
-	_Udp.beginPacket(_switcherIP,  9910);
-	_Udp.write(_packetBuffer,length);
-	_Udp.endPacket(); 	// TODO: Figure out why this may hang!!
+void ATEMbase::_sendPacketBuffer(uint16_t length)	{
+	_sendDatagram(_packetBuffer, length);
+}
+void ATEMbase::_sendDatagram(const uint8_t *data, uint16_t length)	{
+	if (_recorder != NULL)	{
+		_recorder->record(ATEM_captureOut, micros(), data, length);
+	}
+	if (_replaying) return;
+
+	_transport->beginPacket(_switcherIP,  9910);
+	_transport->write(data,length);
+	_transport->endPacket(); 	// TODO: Figure out why this may hang!!
 }
 
 /**
@@ -379,92 +747,79 @@ void ATEMbase::_wipeCleanPacketBuffer() {
 	memset(_packetBuffer, 0, ATEM_packetBufferLength);
 }
 
-/**
- * Reads from UDP channel to buffer. Will fill the buffer to the max or to the size of the current segment being parsed
- * Returns false if there are no more bytes, otherwise true 
- */
-bool ATEMbase::_readToPacketBuffer() {
-	return _readToPacketBuffer(ATEM_packetBufferLength);
-}
-bool ATEMbase::_readToPacketBuffer(uint8_t maxBytes) {
-	maxBytes = maxBytes<=ATEM_packetBufferLength ? maxBytes : ATEM_packetBufferLength;
-	int remainingBytes = _cmdLength-8-_cmdPointer;
-
-	if (remainingBytes>0)	{
-		if (remainingBytes <= maxBytes)	{
-			_Udp.read(_packetBuffer, remainingBytes);
-			_cmdPointer+= remainingBytes;
-			return false;	// Returns false if finished.
-		} else {
-			_Udp.read(_packetBuffer, maxBytes);
-			_cmdPointer+= maxBytes;
-			return true;	// Returns true if there are still bytes to be read.
-		}
-	} else {
-		return false;
-	}
-}
-
 /**
  * If a package longer than a normal acknowledgement is received from the ATEM Switcher we must read through the contents.
  * Usually such a package contains updated state information about the mixer
- * Selected information is extracted in this function and transferred to internal variables in this library.
+ * The commands are handed to _parseGetCommands() as views into packet (_receiveBuffer, or a held back packet), so nothing is copied.
+ * packetLength is the number of bytes of the datagram available in packet.
  */
-void ATEMbase::_parsePacket(uint16_t packetLength)	{
+void ATEMbase::_parsePacket(const uint8_t *packet, uint16_t packetLength)	{
 	
  		// If packet is more than an ACK packet (= if its longer than 12 bytes header), lets parse it:
-      uint16_t indexPointer = 12;	// 12 bytes has already been read from the packet...
-      while (indexPointer < packetLength)  {
+      uint16_t indexPointer = 12;	// The first 12 bytes are the header
+      while (indexPointer+8 <= packetLength)  {
 
         // Read the length of segment (first word):
-        _Udp.read(_packetBuffer, 8);
-        _cmdLength = word(_packetBuffer[0], _packetBuffer[1]);
-		_cmdPointer = 0;
+        const uint8_t *cmd = packet+indexPointer;
+        _cmdLength = word(cmd[0], cmd[1]);
         
-			// Get the "command string", basically this is the 4 char variable name in the ATEM memory holding the various state values of the system:
-        char cmdStr[] = { 
-          _packetBuffer[4], _packetBuffer[5], _packetBuffer[6], _packetBuffer[7], '\0'};
+			// Get the "command string", basically this is the 4 char variable name in the ATEM memory holding the various state values of the system.
+			// It's handled as one integer (see ATEM_fourCC), so subclasses can dispatch on it with a switch instead of string compares:
+        uint32_t cmdName = ATEM_fourCC(cmd[4], cmd[5], cmd[6], cmd[7]);
+
+			// If length of segment larger than 8 (should always be...!) and the whole command is within the datagram
+        if (_cmdLength>8 && indexPointer+_cmdLength <= packetLength)  {
+			if (_commandCache != NULL)	{
+				_commandCache->store(cmdName, cmd+8, _cmdLength-8);
+			}
 
-			// If length of segment larger than 8 (should always be...!)
-        if (_cmdLength>8)  {
-			_parseGetCommands(cmdStr);
+			if (_isSubscribed(cmdName))	{
+				_parseGetCommands(cmdName, cmd+8, _cmdLength-8);
+				_parsedCommands++;
+			} else {
+				_skippedCommands++;
+			}
 
-			while (_readToPacketBuffer())	{}	// Empty, if not done yet.
 			indexPointer+=_cmdLength;
         } else { 
-      		indexPointer = 2000;
          	#if ATEM_debug 
-				if (_serialOutput & 0x80) Serial.println(F("Bad CMD length, flushing..."));
+				if (_serialOutput & 0x80) Serial.println(F("Bad CMD length, skipping rest of packet..."));
 			#endif
-		  
-			// Flushing the buffer:
-	          while(_Udp.available()) {
-	              _Udp.read(_packetBuffer, ATEM_packetBufferLength);
-	          }
+			break;
         }
       }
 }
 
+/**
+ * Whether cmdName passes the command filter, see setCommandFilter(). Tally deltas from a TallyServer (TlDl) go with TlIn,
+ * as they carry the same state.
+ */
+bool ATEMbase::_isSubscribed(uint32_t cmdName) {
+	if (cmdName == ATEM_fourCC('T','l','D','l'))	{
+		cmdName = ATEM_fourCC('T','l','I','n');
+	}
+	bool subscribed = _commandFilter == NULL;
+	for (uint8_t i = 0; !subscribed && i < _commandFilterLength; i++) {
+		subscribed = _commandFilter[i] == cmdName;
+	}
+	return subscribed;
+}
+
 /**
  * This method should be overloaded in subclasses in order to handle specific get-commands
+ * cmd is the command name as made by ATEM_fourCC(), cmdData points to the cmdDataLength bytes of the command following its 8 byte command header.
  */
-void ATEMbase::_parseGetCommands(const char *cmdString)	{
+void ATEMbase::_parseGetCommands(uint32_t cmd, const uint8_t *cmdData, uint16_t cmdDataLength)	{
 //	uint8_t mE, keyer, mediaPlayer, aUXChannel, windowIndex, multiViewer, memory, colorGenerator, box;
 //	uint16_t audioSource, videoSource;
 //	long temp;
-	
-	uint8_t numberOfReads=1;
-	while(_readToPacketBuffer())	{
-		numberOfReads++;
-	}
 
 	#if ATEM_debug
  	if (_serialOutput & 0x80) {
+		char cmdString[] = { (char)(cmd>>24), (char)(cmd>>16), (char)(cmd>>8), (char)cmd, '\0' };
 		Serial.print(cmdString);
 		Serial.print(", len: ");
-		Serial.print(_cmdLength);
-		Serial.print(", rds: ");
-		Serial.println(numberOfReads);
+		Serial.println(_cmdLength);
 	}
 	#endif
 }
@@ -476,15 +831,25 @@ void ATEMbase::_prepareCommandPacket(const char *cmdString, uint8_t cmdBytes, bo
 			if (_returnPacketLength>0 && (!indexMatch || strncmp_P((char *)(_packetBuffer+12+_cBBO+4), cmdString, 4)))	{
 				_cBBO = _returnPacketLength-12;
 	  		}
+			// If the new command doesn't fit, the commands bundled so far go out as one datagram, and the bundle goes on in a new one:
+			if (_cBBO>0 && 12+_cBBO+(4+4+cmdBytes) > ATEM_packetBufferLength)	{
+				if (!_sendCommandPacket(12+_cBBO))	{
+					_bundleOverrun = true;
+				}
+				_wipeCleanPacketBuffer();
+				_cBBO = 0;
+				_bundleSplits++;
+			}
 		} else { 
 			_wipeCleanPacketBuffer();	// For command bundles, this is already done...
 		}
 
   	  _returnPacketLength = 12+_cBBO+(4+4+cmdBytes);
   
-	  // Because we increased length of command, we need to check for buffer overflow:
+	  // Bundles are split above, so this only happens if a single command is longer than the buffer. The caller fills in the command
+	  // right after this, so there is no way to go on. ATEM_packetBufferLength must be set to fit the longest command sent:
   	  if (_returnPacketLength > ATEM_packetBufferLength)	{
-  	  	  Serial.println(F("FATAL ERROR: Packet Buffer Overflow in the ATEM Library! Too long or too many commands bundled!\n HALT"));
+  	  	  Serial.println(F("FATAL ERROR: Packet Buffer Overflow in the ATEM Library! Command longer than ATEM_packetBufferLength!\n HALT"));
   		  while(true){}	// STOP!
   	  }	
 
@@ -497,15 +862,14 @@ void ATEMbase::_prepareCommandPacket(const char *cmdString, uint8_t cmdBytes, bo
 		#endif
 
 	  // Command length:
-	  _packetBuffer[12+_cBBO] = 0;	// MSB - but it's always under 256, so....
-	  _packetBuffer[12+1+_cBBO] = 4+4+cmdBytes;	// LSB
+	  _packetBuffer[12+_cBBO] = highByte(4+4+cmdBytes);	// MSB
+	  _packetBuffer[12+1+_cBBO] = lowByte(4+4+cmdBytes);	// LSB
 }
 
 void ATEMbase::_finishCommandPacket()	{
 	if (!_cBundle)	{	
 
-	  _createCommandHeader(ATEM_headerCmd_AckRequest, _returnPacketLength);
-	  _sendPacketBuffer(_returnPacketLength);
+	  _sendCommandPacket(_returnPacketLength);
 	  _returnPacketLength = 0;
 
 	} else {
@@ -528,6 +892,647 @@ void ATEMbase::_finishCommandPacket()	{
  *
  **************/
 
+/**************
+ *
+ * Reliable command packets
+ *
+ **************/
+
+/**
+ * Sends the command packet in the packet buffer with an ack request, and keeps a copy of it
+ * so it can be retransmitted until the ATEM acknowledges it.
+ * Returns false if the window was full, so an unacknowledged packet was given up on to make room.
+ */
+bool ATEMbase::_sendCommandPacket(uint16_t length)	{
+	_createCommandHeader(ATEM_headerCmd_AckRequest, length);
+	_sendPacketBuffer(length);
+
+	CommandPacket *packet = &_commandPackets[_localPacketIdCounter % ATEM_outgoingWindowSize];
+	bool windowFull = packet->_inFlight;
+	if (windowFull)	{	// Window is full - the oldest packet is given up on to make room
+		_commandsLost++;
+	}
+	packet->_inFlight = true;
+	packet->_packetId = _localPacketIdCounter;
+	packet->_length = length;
+	packet->_retransmits = 0;
+	packet->_sentAt = packet->_lastSentAt = millis();
+	packet->_sentAtMicros = micros();
+	packet->_timeout = _retransmitTimeout;
+	memcpy(packet->_data, _packetBuffer, length);
+	return !windowFull;
+}
+
+/**
+ * Handles an acknowledge from the ATEM. Acknowledges are cumulative, so all command packets up to and including
+ * ackedPacketId are done. The round trip time is estimated from packets that were not retransmitted (as in RFC 6298).
+ */
+void ATEMbase::_handleAck(uint16_t ackedPacketId)	{
+	for (uint8_t i = 0; i < ATEM_outgoingWindowSize; i++)	{
+		CommandPacket *packet = &_commandPackets[i];
+		if (!packet->_inFlight || _isPacketIdAfter(packet->_packetId, ackedPacketId)) continue;
+
+		packet->_inFlight = false;
+		uint16_t latency = millis() - packet->_sentAt;
+		if (packet->_packetId == ackedPacketId)	{
+			_lastAckedPacketId = ackedPacketId;
+			_lastAckLatency = latency;
+		}
+
+		if (packet->_retransmits == 0)	{
+			unsigned long rttMicros = micros() - packet->_sentAtMicros;
+			if (_latencyStats.ackRoundTrip.count > 0)	{
+				_addToHistogram(&_latencyStats.ackJitter, rttMicros > _lastAckRoundTrip ? rttMicros - _lastAckRoundTrip : _lastAckRoundTrip - rttMicros);
+			}
+			_addToHistogram(&_latencyStats.ackRoundTrip, rttMicros);
+			_lastAckRoundTrip = rttMicros;
+
+			uint16_t rtt = latency;
+			if (_srtt8 == 0)	{
+				_srtt8 = (rtt << 3) | 1;	// Never 0 once measured
+				_rttvar4 = rtt << 1;
+			} else {
+				int16_t delta = rtt - (_srtt8 >> 3);
+				_srtt8 += delta;
+				if (delta < 0) delta = -delta;
+				_rttvar4 += delta - (_rttvar4 >> 2);
+			}
+			uint16_t timeout = (_srtt8 >> 3) + (_rttvar4 > 0 ? _rttvar4 : 1);
+			_retransmitTimeout = constrain(timeout, ATEM_minRetransmitTimeout, ATEM_maxRetransmitTimeout);
+		}
+
+		if (_serialOutput>1)	{
+			Serial.print(F("Command packet "));
+			Serial.print(packet->_packetId, DEC);
+			Serial.print(F(" acked after "));
+			Serial.print(latency, DEC);
+			Serial.println(F(" ms"));
+		}
+	}
+}
+
+/**
+ * Retransmits command packets which haven't been acknowledged within their timeout.
+ * The timeout doubles on every retransmission, and a packet is given up on after ATEM_maxRetransmits.
+ */
+void ATEMbase::_retransmitCommandPackets()	{
+	for (uint8_t i = 0; i < ATEM_outgoingWindowSize; i++)	{
+		CommandPacket *packet = &_commandPackets[i];
+		if (!packet->_inFlight || !hasTimedOut(packet->_lastSentAt, packet->_timeout)) continue;
+
+		if (packet->_retransmits >= ATEM_maxRetransmits)	{
+			packet->_inFlight = false;
+			_commandsLost++;
+			if (_serialOutput) {
+				Serial.print(F("Command packet "));
+				Serial.print(packet->_packetId, DEC);
+				Serial.println(F(" was never acked - giving up"));
+			}
+			continue;
+		}
+
+		_resendCommandPacket(packet);
+		packet->_timeout = packet->_timeout < ATEM_maxRetransmitTimeout/2 ? packet->_timeout*2 : ATEM_maxRetransmitTimeout;
+
+		if (_serialOutput>1)	{
+			Serial.print(F("Retransmitting command packet "));
+			Serial.println(packet->_packetId, DEC);
+		}
+	}
+}
+
+/**
+ * Sends a command packet from the history again, flagged as resent
+ */
+void ATEMbase::_resendCommandPacket(CommandPacket *packet)	{
+	packet->_data[0] |= ATEM_headerCmd_Resend << 3;
+	_sendDatagram(packet->_data, packet->_length);
+
+	packet->_retransmits++;
+	packet->_lastSentAt = millis();
+	_commandRetransmits++;
+}
+
+/**
+ * Resends the command packet with packetId, and the ones sent after it, from the command packet history.
+ * This is how the ATEM's request for resending (ATEM_headerCmd_RequestNextAfter) is answered.
+ * Returns false if packetId is not in the history.
+ */
+bool ATEMbase::_resendCommandPacketsFrom(uint16_t packetId)	{
+	CommandPacket *packet = &_commandPackets[packetId % ATEM_outgoingWindowSize];
+	if (packet->_length == 0 || packet->_packetId != packetId) return false;
+
+	while (true)	{
+		_resendCommandPacket(packet);
+		if (packetId == _localPacketIdCounter) break;
+
+		packetId = (packetId + 1) % ATEM_maxPacketId;
+		packet = &_commandPackets[packetId % ATEM_outgoingWindowSize];
+		if (packet->_length == 0 || packet->_packetId != packetId) break;
+	}
+	return true;
+}
+
+/**
+ * Makes room for packetId in the bitmap of missed initialization packages. New room is marked as missed.
+ * Returns false if packetId is beyond ATEM_initPackageLimit or the memory couldn't be allocated, in which case packetId isn't tracked.
+ */
+bool ATEMbase::_resizeMissedInitializationPackages(uint16_t packetId)	{
+	if (packetId >= ATEM_initPackageLimit) return false;	// The packet ID comes from the switcher, so the allocation is bounded
+
+	uint16_t length = ((packetId>>3) + 8) & ~7;	// Grow in steps of 64 packages
+	uint8_t *bitmap = new uint8_t[length];
+	if (bitmap == NULL) return false;
+
+	memset(bitmap, 0xFF, length);
+	if (_missedInitializationPackages != NULL)	{
+		memcpy(bitmap, _missedInitializationPackages, _missedInitializationPackagesLength);
+		delete[] _missedInitializationPackages;
+	}
+	_missedInitializationPackages = bitmap;
+	_missedInitializationPackagesLength = length;
+	return true;
+}
+
+bool ATEMbase::_isInitializationPackageMissed(uint16_t packetId)	{
+	return packetId < _missedInitializationPackagesLength*8 && (_missedInitializationPackages[packetId>>3] & (B1<<(packetId & 0x7)));
+}
+
+/**
+ * Asks the ATEM to resend missed initialization packages. Up to ATEM_initRecoveryDepth requests are outstanding at the same time,
+ * each of them repeated if the package hasn't arrived within the retransmit timeout.
+ * Sets _hasInitialized when no packages are missing anymore.
+ */
+void ATEMbase::_requestMissedInitializationPackages()	{
+	uint8_t freeRequests = 0;
+	for (uint8_t i = 0; i < ATEM_initRecoveryDepth; i++)	{
+		InitPackageRequest *request = &_initPackageRequests[i];
+		if (request->_packetId != 0 && (!_isInitializationPackageMissed(request->_packetId) || hasTimedOut(request->_requestedAt, _retransmitTimeout)))	{
+			request->_packetId = 0;		// Arrived, or asked for again below
+		}
+		if (request->_packetId == 0) freeRequests++;
+	}
+
+	uint16_t lastPacketId = _initPayloadSentAtPacketId < _missedInitializationPackagesLength*8 ? _initPayloadSentAtPacketId : _missedInitializationPackagesLength*8;
+	bool missing = false;
+	for (uint16_t i = 1; i < lastPacketId; i++)	{
+		if (_missedInitializationPackages[i>>3] == 0)	{	// Skip whole bytes of received packages
+			i |= 0x7;
+			continue;
+		}
+		if (!_isInitializationPackageMissed(i)) continue;
+		missing = true;
+		if (freeRequests == 0) break;
+
+		uint8_t free = ATEM_initRecoveryDepth;
+		bool requested = false;
+		for (uint8_t j = 0; j < ATEM_initRecoveryDepth; j++)	{
+			if (_initPackageRequests[j]._packetId == i) requested = true;
+			else if (_initPackageRequests[j]._packetId == 0) free = j;
+		}
+		if (requested) continue;
+
+		#if ATEM_debug
+		if (_serialOutput & 0x80) 	{
+      		Serial.print(F("Asking for package "));
+		    Serial.println(i, DEC);
+		}
+		#endif
+		_wipeCleanPacketBuffer();
+		_createCommandHeader(ATEM_headerCmd_RequestNextAfter, 12);
+	    _packetBuffer[6] = highByte(i-1);  // Resend Packet ID, MSB
+	    _packetBuffer[7] = lowByte(i-1);  // Resend Packet ID, LSB
+	    _packetBuffer[8] = 0x01;
+		_sendPacketBuffer(12);
+
+		_initPackageRequests[free]._packetId = i;
+		_initPackageRequests[free]._requestedAt = millis();
+		_initPackageRequestCount++;
+		freeRequests--;
+	}
+
+	if (!missing)	{
+		_hasInitialized = true;
+		_initDuration = millis() - _connectedAt;
+		_setConnectionPhase(ATEM_phaseConnected);
+
+		for (uint16_t i = (_remoteContiguousPacketId + 1) % ATEM_maxPacketId; _isPacketIdAfter(_remoteNextPacketId, i); i = (i + 1) % ATEM_maxPacketId)	{	// Live updates parsed before the end of the initialization was known
+			if (i < _missedInitializationPackagesLength*8 && !_isInitializationPackageMissed(i)) _markRemotePacketApplied(i);
+		}
+		_applyHeldPackets();	// The live updates held back meanwhile
+		_ackPending = true;
+		if (_serialOutput) {
+			Serial.println(F("ATEM _hasInitialized = TRUE"));
+			Serial.print(F("Initialization took "));
+			Serial.print(_initDuration);
+			Serial.print(F(" ms, "));
+			Serial.print(_initPackageRequestCount);
+			Serial.println(F(" packages asked for again"));
+			Serial.print(F("Commands parsed: "));
+			Serial.print(_parsedCommands);
+			Serial.print(F(", skipped: "));
+			Serial.println(_skippedCommands);
+		}
+	}
+}
+
+/**
+ * Parses the packet in _receiveBuffer in the order of remote packet IDs, so a late packet can't overwrite newer state (e.g. tally) with older.
+ * During the initialization packages are parsed as they come, as missed ones are asked for again anyway, and only repeats are dropped.
+ * Live updates after the last initialization package are held back until the missed ones are in, so those can't overwrite them.
+ * After that a packet arriving ahead of a missing one is held back until the gap is filled or the reorder timeout has passed.
+ * A packet before the next expected one is dropped if it was parsed already. If it's one of the missing packets that were given up on,
+ * it's parsed anyway, as the state in it would be lost otherwise.
+ */
+void ATEMbase::_sequencePacket(uint8_t headerBitmask, uint16_t readLength, bool duplicate)	{
+	uint16_t packetId = _lastRemotePacketID;
+	if (!(headerBitmask & ATEM_headerCmd_AckRequest))	{	// Not numbered
+		_parsePacket(_receiveBuffer, readLength);
+		return;
+	}
+
+	uint16_t distance = (packetId - _remoteNextPacketId) & (ATEM_maxPacketId-1);
+	if (!_hasInitialized)	{
+		if (duplicate)	{
+			_duplicatePackets++;
+			return;
+		}
+		if (_initPayloadSent && _isPacketIdAfter(packetId, _initPayloadSentAtPacketId))	{	// A live update
+			HeldPacket *held = &_heldPackets[packetId % ATEM_reorderWindow];
+			if (distance < ATEM_reorderWindow && readLength <= ATEM_reorderSlotLength && !(held->_length > 0 && held->_packetId == packetId))	{
+				held->_packetId = packetId;
+				held->_length = readLength;
+				held->_heldAt = millis();
+				memcpy(held->_data, _receiveBuffer, readLength);
+				_reorderedPackets++;
+			}
+			return;		// Otherwise dropped. It isn't acknowledged, so the switcher sends it again
+		}
+		if (!_isPacketIdAfter(_remoteNextPacketId, packetId))	{
+			_remoteNextPacketId = (packetId + 1) % ATEM_maxPacketId;
+		}
+		_parsePacket(_receiveBuffer, readLength);
+		return;
+	}
+
+	if (distance >= ATEM_maxPacketId/2)	{	// Before the next expected packet
+		if (_isRemotePacketApplied(packetId))	{
+			_duplicatePackets++;
+			return;
+		}
+		_applyPacket(_receiveBuffer, readLength, packetId);
+		_latePackets++;
+		return;
+	}
+	if (distance > 0)	{	// Ahead of a missing packet
+		HeldPacket *held = &_heldPackets[packetId % ATEM_reorderWindow];
+		if (held->_length > 0 && held->_packetId == packetId)	{
+			_duplicatePackets++;
+			return;
+		}
+		if (distance <= ATEM_reorderWindow && readLength <= ATEM_reorderSlotLength)	{
+			held->_packetId = packetId;
+			held->_length = readLength;
+			held->_heldAt = millis();
+			memcpy(held->_data, _receiveBuffer, readLength);
+			_reorderedPackets++;
+			return;
+		}
+		_skipToPacketId(packetId);	// Too far ahead or too long to hold back
+	}
+
+	_applyPacket(_receiveBuffer, readLength, packetId);
+	_remoteNextPacketId = (packetId + 1) % ATEM_maxPacketId;
+	_applyHeldPackets();
+}
+
+/**
+ * Handles a fan-out datagram: tally state a TallyServer sends once to all its clients (broadcast or multicast) instead of to each of them.
+ * It has no flags and no session, and is numbered by a sequence of its own in the packet ID field. It is parsed once initialized,
+ * unless a later one was parsed already, and acknowledged with a datagram without flags, carrying the sequence where an ack has the packet ID.
+ * A server that doesn't get that acknowledge sends the state to this client on its own again. To get fan-outs, connect from the fan-out port
+ * of the server (see setFixedLocalPort()).
+ */
+void ATEMbase::_handleFanOut(uint16_t packetSize, uint16_t readLength)	{
+	uint16_t sequence = word(_receiveBuffer[10], _receiveBuffer[11]);
+	if (!_hasInitialized || packetSize != word(_receiveBuffer[0] & B00000111, _receiveBuffer[1]))	{
+		return;
+	}
+	_lastContact = millis();
+
+	if (_fanOutSequence == 0 || _isPacketIdAfter(sequence, _fanOutSequence))	{
+		_fanOutSequence = sequence;
+		_fanOutPackets++;
+		_parsePacket(_receiveBuffer, readLength);
+	}
+
+	_wipeCleanPacketBuffer();
+	_createCommandHeader(ATEM_headerCmd_Ack, 12, sequence);
+	_packetBuffer[0] &= B00000111;	// Overruling the flags. No flags is what tells the server this acknowledges a fan-out
+	_sendPacketBuffer(12);
+}
+
+/**
+ * Gives up on the packets missing before packetId: the held back packets before it are parsed in order, and packetId is the next expected one.
+ * The missing ones stay unacknowledged, so the switcher sends them again, and they are parsed if they arrive after all.
+ */
+void ATEMbase::_skipToPacketId(uint16_t packetId)	{
+	for (uint8_t i = 1; i <= ATEM_reorderWindow; i++)	{	// Held back packets are at most ATEM_reorderWindow ahead
+		uint16_t heldPacketId = (_remoteNextPacketId + i) % ATEM_maxPacketId;
+		if (!_isPacketIdAfter(packetId, heldPacketId)) break;
+
+		HeldPacket *held = &_heldPackets[heldPacketId % ATEM_reorderWindow];
+		if (held->_length > 0 && held->_packetId == heldPacketId)	{
+			_applyPacket(held->_data, held->_length, heldPacketId);
+			held->_length = 0;
+		}
+	}
+	_remoteNextPacketId = packetId;
+	_skippedGaps++;
+}
+
+/**
+ * Parses the held back packets that are next in order
+ */
+void ATEMbase::_applyHeldPackets()	{
+	while (true)	{
+		HeldPacket *held = &_heldPackets[_remoteNextPacketId % ATEM_reorderWindow];
+		if (held->_length == 0 || held->_packetId != _remoteNextPacketId) break;
+
+		_applyPacket(held->_data, held->_length, held->_packetId);
+		held->_length = 0;
+		_remoteNextPacketId = (_remoteNextPacketId + 1) % ATEM_maxPacketId;
+	}
+}
+
+/**
+ * Gives up on missing packets once a packet after them has been held back for the reorder timeout
+ */
+void ATEMbase::_releaseHeldPackets()	{
+	while (true)	{
+		bool timedOut = false;
+		uint16_t firstPacketId = 0;
+		uint16_t firstDistance = ATEM_maxPacketId;
+		for (uint8_t i = 0; i < ATEM_reorderWindow; i++)	{
+			HeldPacket *held = &_heldPackets[i];
+			if (held->_length == 0) continue;
+
+			uint16_t distance = (held->_packetId - _remoteNextPacketId) & (ATEM_maxPacketId-1);
+			if (distance < firstDistance)	{
+				firstDistance = distance;
+				firstPacketId = held->_packetId;
+			}
+			if (hasTimedOut(held->_heldAt, _reorderTimeout())) timedOut = true;
+		}
+		if (!timedOut) return;
+
+		_skipToPacketId(firstPacketId);
+		_applyHeldPackets();
+	}
+}
+
+/**
+ * Asks for the first packet that was given up on, once per retransmit timeout until it's in. A switcher would send it again anyway
+ * since it isn't acknowledged, but a TallyServer only answers a resend request, with the current tally state.
+ */
+void ATEMbase::_requestSkippedPacket()	{
+	if (!_isPacketIdAfter(_remoteNextPacketId, (_remoteContiguousPacketId + 1) % ATEM_maxPacketId) || !hasTimedOut(_skippedPacketRequestedAt, _retransmitTimeout))	{
+		return;		// Nothing missing before the next expected packet, or asked for recently
+	}
+
+	_wipeCleanPacketBuffer();
+	_createCommandHeader(ATEM_headerCmd_RequestNextAfter, 12);
+	_packetBuffer[6] = highByte(_remoteContiguousPacketId);	// Resend Packet ID, MSB
+	_packetBuffer[7] = lowByte(_remoteContiguousPacketId);	// Resend Packet ID, LSB
+	_packetBuffer[8] = 0x01;
+	_sendPacketBuffer(12);
+	_skippedPacketRequestedAt = millis();
+}
+
+/**
+ * Time (ms) a packet is held back before the missing ones before it are given up on. That's the retransmit timeout,
+ * by which the switcher should have sent a lost packet again, or ATEM_reorderTimeout until the round trip time is measured.
+ */
+uint16_t ATEMbase::_reorderTimeout()	{
+	return _srtt8 == 0 ? ATEM_reorderTimeout : _retransmitTimeout;
+}
+
+/**
+ * Parses a packet from the switcher, and keeps track of it for the acknowledges
+ */
+void ATEMbase::_applyPacket(const uint8_t *packet, uint16_t length, uint16_t packetId)	{
+	_parsePacket(packet, length);
+	_markRemotePacketApplied(packetId);
+}
+
+/**
+ * Keeps track of the highest remote packet ID up to which everything has been parsed, which is what's acknowledged.
+ * The ATEM takes an acknowledge as covering all packets before it, so packets after a gap are not acknowledged until the gap is filled,
+ * also when it was given up on. Only if a gap is more than 32 packets behind it's given up on for good, as it can't be kept track of.
+ */
+void ATEMbase::_markRemotePacketApplied(uint16_t packetId)	{
+	uint16_t distance = (packetId - _remoteContiguousPacketId) & (ATEM_maxPacketId-1);
+	if (distance == 0 || distance >= ATEM_maxPacketId/2)	{	// Already parsed
+		return;
+	}
+	if (distance > 32)	{
+		uint16_t shift = distance - 32;
+		_remoteAppliedAhead = shift < 32 ? _remoteAppliedAhead >> shift : 0;
+		_remoteContiguousPacketId = (_remoteContiguousPacketId + shift) % ATEM_maxPacketId;
+		distance = 32;
+	}
+
+	_remoteAppliedAhead |= 1UL << (distance-1);
+	while (_remoteAppliedAhead & 1)	{
+		_remoteAppliedAhead >>= 1;
+		_remoteContiguousPacketId = (_remoteContiguousPacketId + 1) % ATEM_maxPacketId;
+	}
+}
+
+/**
+ * True if the packet with the remote packet ID has been parsed. Only a packet before the next expected one is asked about,
+ * which is at most 32 ahead of _remoteContiguousPacketId.
+ */
+bool ATEMbase::_isRemotePacketApplied(uint16_t packetId)	{
+	uint16_t distance = (packetId - _remoteContiguousPacketId) & (ATEM_maxPacketId-1);
+	if (distance == 0 || distance >= ATEM_maxPacketId/2) return true;
+	return distance <= 32 && (_remoteAppliedAhead & (1UL << (distance-1)));
+}
+
+/**
+ * Acknowledges the remote packet ID to the ATEM
+ */
+void ATEMbase::_sendAck(uint16_t packetId)	{
+	_wipeCleanPacketBuffer();
+	_createCommandHeader(ATEM_headerCmd_Ack, 12, packetId);
+	_sendPacketBuffer(12);
+	_acksSent++;
+}
+
+/**
+ * Counts value in the log2 bucket it belongs to
+ */
+void ATEMbase::_addToHistogram(ATEMhistogram *histogram, unsigned long value)	{
+	uint8_t bucket = 0;
+	while (value >> bucket && bucket < ATEM_histogramBuckets-1) bucket++;
+	histogram->buckets[bucket]++;
+	histogram->count++;
+	histogram->sum += value;
+	if (value > histogram->max) histogram->max = value;
+}
+
+/**
+ * Wrap-safe comparison of 15 bit packet IDs. True if packetId is later than otherPacketId,
+ * i.e. less than half the ID range ahead of it.
+ */
+bool ATEMbase::_isPacketIdAfter(uint16_t packetId, uint16_t otherPacketId)	{
+	uint16_t distance = (packetId - otherPacketId) & (ATEM_maxPacketId - 1);
+	return distance != 0 && distance < (ATEM_maxPacketId >> 1);
+}
+
+/**
+ * ID of the latest command packet acknowledged by the switcher
+ */
+uint16_t ATEMbase::getLastAckedPacketId()	{
+	return _lastAckedPacketId;
+}
+
+/**
+ * Time (ms) it took for the switcher to acknowledge the latest acknowledged command packet, including any retransmissions
+ */
+uint16_t ATEMbase::getLastAckLatency()	{
+	return _lastAckLatency;
+}
+
+/**
+ * Smoothed round trip time (ms) to the switcher, measured on command packets. 0 if not measured yet.
+ */
+uint16_t ATEMbase::getRoundTripTime()	{
+	return _srtt8 >> 3;
+}
+
+/**
+ * Current timeout (ms) before an unacknowledged command packet is retransmitted
+ */
+uint16_t ATEMbase::getRetransmitTimeout()	{
+	return _retransmitTimeout;
+}
+
+/**
+ * Number of command packet retransmissions since begin()
+ */
+unsigned long ATEMbase::getCommandRetransmitCount()	{
+	return _commandRetransmits;
+}
+
+/**
+ * Number of command packets never acknowledged by the switcher since begin()
+ */
+unsigned long ATEMbase::getCommandsLostCount()	{
+	return _commandsLost;
+}
+
+/**
+ * Number of command packets that can be sent before unacknowledged ones are pushed out of the retransmit window.
+ * A sketch sending a lot of commands (e.g. a macro in a bundle) should wait for this, calling runLoop() meanwhile, instead of sending right away.
+ */
+uint8_t ATEMbase::getCommandWindowSpace()	{
+	uint8_t space = 0;
+	for (uint8_t i = 0; i < ATEM_outgoingWindowSize; i++)	{
+		if (!_commandPackets[i]._inFlight) space++;
+	}
+	return space;
+}
+
+/**
+ * Number of times since begin() a command bundle was split, because it didn't fit in one datagram
+ */
+unsigned long ATEMbase::getCommandBundleSplitCount()	{
+	return _bundleSplits;
+}
+
+/**
+ * Number of resend requests from the switcher answered from the command packet history since begin()
+ */
+unsigned long ATEMbase::getResendRequestsServedCount()	{
+	return _resendRequestsServed;
+}
+
+/**
+ * Number of resend requests from the switcher for packets no longer in the command packet history since begin()
+ */
+unsigned long ATEMbase::getResendRequestsMissedCount()	{
+	return _resendRequestsMissed;
+}
+
+/**
+ * Sets how long (ms) the switcher may be silent before it's probed, and before the connection is considered lost
+ * Defaults are ATEM_probeInterval and ATEM_connectionTimeout. Can be set before or after begin()
+ */
+void ATEMbase::setConnectionTimeouts(uint16_t probeInterval, uint16_t connectionTimeout)	{
+	_probeInterval = probeInterval;
+	_connectionTimeout = connectionTimeout;
+}
+
+/**
+ * Connect from port every time, also when reconnecting on its own, instead of a new random port. Needed to get the fan-out of a TallyServer,
+ * which is sent to TALLY_SERVER_FAN_OUT_PORT (9911) by default. 0 goes back to random ports. Takes effect from the next begin()
+ */
+void ATEMbase::setFixedLocalPort(uint16_t port)	{
+	_fixedLocalPort = port;
+}
+
+/**
+ * Histograms (us) of the round trip time and its jitter for command packets, and of the time from reading a datagram until it's parsed.
+ * Collected since begin() or resetLatencyStats()
+ */
+const ATEMlatencyStats &ATEMbase::getLatencyStats()	{
+	return _latencyStats;
+}
+
+void ATEMbase::resetLatencyStats()	{
+	memset(&_latencyStats, 0, sizeof(_latencyStats));
+	_lastAckRoundTrip = 0;
+}
+
+/**
+ * Current connection phase, one of the ATEM_phase* values
+ */
+uint8_t ATEMbase::getConnectionPhase()	{
+	return _connectionPhase;
+}
+
+/**
+ * Time (ms) from the last contact before the latest connection loss, until the switcher was connected and initialized again.
+ * This is how long a tally could have shown a stale state.
+ */
+unsigned long ATEMbase::getLastReconnectDuration()	{
+	return _lastReconnectDuration;
+}
+
+/**
+ * Number of times the connection was lost and established again since begin()
+ */
+unsigned long ATEMbase::getReconnectCount()	{
+	return _reconnects;
+}
+
+/**
+ * Time (ms) from connecting until all initialization packages were received, 0 until initialized
+ */
+unsigned long ATEMbase::getInitDuration()	{
+	return _initDuration;
+}
+
+/**
+ * Number of resend requests for missed initialization packages since begin()
+ */
+unsigned long ATEMbase::getInitPackageRequestCount()	{
+	return _initPackageRequestCount;
+}
+
+
+
 /**
  * Setter method: If _serialOutput is set, the library may use Serial.print() to give away information about its operation - mostly for debugging.
  * 0= no output
@@ -543,7 +1548,7 @@ void ATEMbase::serialOutput(uint8_t level) {
  * Timeout check
  */
 bool ATEMbase::hasTimedOut(unsigned long time, unsigned long timeout)  {
-  if ((unsigned long)(time + timeout) <= (unsigned long)millis())  {  // This should "wrap around" if time+timout is larger than the size of unsigned-longs, right?
+  if ((unsigned long)(millis() - time) >= timeout)  {  // Wrap-safe, as long as time isn't older than the range of unsigned long
     return true;
   } 
   else {
@@ -589,346 +1594,162 @@ uint16_t ATEMbase::audioDb2Word(float input)  {  // -48 to +6 input
 
 
 
-uint8_t ATEMbase::getVideoSrcIndex(uint16_t videoSrc)	{
-	switch(videoSrc){
-		case 0:  // Black
-			return 0;
-		case 1:  // Input 1
-			return 1;
-		case 2:  // Input 2
-			return 2;
-		case 3:  // Input 3
-			return 3;
-		case 4:  // Input 4
-			return 4;
-		case 5:  // Input 5
-			return 5;
-		case 6:  // Input 6
-			return 6;
-		case 7:  // Input 7
-			return 7;
-		case 8:  // Input 8
-			return 8;
-		case 9:  // Input 9
-			return 9;
-		case 10:  // Input 10
-			return 10;
-		case 11:  // Input 11
-			return 11;
-		case 12:  // Input 12
-			return 12;
-		case 13:  // Input 13
-			return 13;
-		case 14:  // Input 14
-			return 14;
-		case 15:  // Input 15
-			return 15;
-		case 16:  // Input 16
-			return 16;
-		case 17:  // Input 17
-			return 17;
-		case 18:  // Input 18
-			return 18;
-		case 19:  // Input 19
-			return 19;
-		case 20:  // Input 20
-			return 20;
-		case 1000:  // Color Bars
-			return 21;
-		case 2001:  // Color 1
-			return 22;
-		case 2002:  // Color 2
-			return 23;
-		case 3010:  // Media Player 1
-			return 24;
-		case 3011:  // Media Player 1 Key
-			return 25;
-		case 3020:  // Media Player 2
-			return 26;
-		case 3021:  // Media Player 2 Key
-			return 27;
-		case 4010:  // Key 1 Mask
-			return 28;
-		case 4020:  // Key 2 Mask
-			return 29;
-		case 4030:  // Key 3 Mask
-			return 30;
-		case 4040:  // Key 4 Mask
-			return 31;
-		case 5010:  // DSK 1 Mask
-			return 32;
-		case 5020:  // DSK 2 Mask
-			return 33;
-		case 6000:  // Super Source
-			return 34;
-		case 7001:  // Clean Feed 1
-			return 35;
-		case 7002:  // Clean Feed 2
-			return 36;
-		case 8001:  // Auxilary 1
-			return 37;
-		case 8002:  // Auxilary 2
-			return 38;
-		case 8003:  // Auxilary 3
-			return 39;
-		case 8004:  // Auxilary 4
-			return 40;
-		case 8005:  // Auxilary 5
-			return 41;
-		case 8006:  // Auxilary 6
-			return 42;
-		case 10010:  // ME 1 Prog
-			return 43;
-		case 10011:  // ME 1 Prev
-			return 44;
-		case 10020:  // ME 2 Prog
-			return 45;
-		case 10021:  // ME 2 Prev
-			return 46;
-		default:
-			return 0;
+/**************
+ *
+ * Source tables
+ *
+ **************/
+
+// Video sources as numbered by the switcher, in ascending order. The index of a source is its position in the table.
+// Covers the largest switchers (4 M/E Constellation): 40 inputs, 4 media players, 16 upstream and 4 downstream keys, 2 Super Sources and 24 aux
+static constexpr uint16_t ATEM_videoSources[] PROGMEM = {
+	// Black
+	0,
+	// Inputs 1-40
+	1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+	11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+	21, 22, 23, 24, 25, 26, 27, 28, 29, 30,
+	31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	// Color Bars
+	1000,
+	// Color 1-2
+	2001, 2002,
+	// Media Player 1-4, each followed by its key
+	3010, 3011, 3020, 3021, 3030, 3031, 3040, 3041,
+	// Key 1-16 Mask (4 per M/E)
+	4010, 4020, 4030, 4040, 4050, 4060, 4070, 4080, 4090, 4100,
+	4110, 4120, 4130, 4140, 4150, 4160,
+	// DSK 1-4 Mask
+	5010, 5020, 5030, 5040,
+	// Super Source 1-2
+	6000, 6001,
+	// Clean Feed 1-4
+	7001, 7002, 7003, 7004,
+	// Auxilary 1-24
+	8001, 8002, 8003, 8004, 8005, 8006, 8007, 8008, 8009, 8010,
+	8011, 8012, 8013, 8014, 8015, 8016, 8017, 8018, 8019, 8020,
+	8021, 8022, 8023, 8024,
+	// ME 1-4 Prog and Prev
+	10010, 10011, 10020, 10021, 10030, 10031, 10040, 10041
+};
+
+// Audio sources as numbered by the switcher, in ascending order. The index of a source is its position in the table.
+static constexpr uint16_t ATEM_audioSources[] PROGMEM = {
+	// Inputs 1-40
+	1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+	11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+	21, 22, 23, 24, 25, 26, 27, 28, 29, 30,
+	31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	// XLR, AES/EBU, RCA
+	1001, 1101, 1201,
+	// Mic 1-2
+	1301, 1302,
+	// MP 1-4
+	2001, 2002, 2003, 2004
+};
+
+#define ATEM_videoSourceCount (sizeof(ATEM_videoSources)/sizeof(ATEM_videoSources[0]))
+#define ATEM_videoInputCount 40		// Inputs are the sources 1 to 40 and have the same index, so they're looked up without searching
+#define ATEM_audioSourceCount (sizeof(ATEM_audioSources)/sizeof(ATEM_audioSources[0]))
+#define ATEM_audioInputCount 40		// Inputs are the sources 1 to 40, with index 0 to 39
+
+static constexpr bool ATEM_isAscending(const uint16_t *sources, size_t length)	{
+	return length < 2 || (sources[0] < sources[1] && ATEM_isAscending(sources+1, length-1));
+}
+static_assert(ATEM_isAscending(ATEM_videoSources, ATEM_videoSourceCount), "ATEM_videoSources must be in ascending order for the binary search");
+static_assert(ATEM_isAscending(ATEM_audioSources, ATEM_audioSourceCount), "ATEM_audioSources must be in ascending order for the binary search");
+static_assert(ATEM_videoSources[ATEM_videoInputCount] == ATEM_videoInputCount && ATEM_videoSources[ATEM_videoInputCount+1] > ATEM_videoInputCount, "ATEM_videoSources must start with Black and the inputs");
+static_assert(ATEM_audioSources[ATEM_audioInputCount-1] == ATEM_audioInputCount && ATEM_audioSources[ATEM_audioInputCount] > ATEM_audioInputCount, "ATEM_audioSources must start with the inputs");
+static_assert(ATEM_videoSourceCount <= 255 && ATEM_audioSourceCount <= 255, "Source indexes must fit in uint8_t");
+
+/**
+ * Binary search for source in a source table in flash. Returns its index, or sourcesLength if it's not in the table.
+ */
+uint8_t ATEMbase::_findSourceIndex(const uint16_t *sources, uint8_t sourcesLength, uint16_t source)	{
+	uint8_t low = 0;
+	uint8_t high = sourcesLength;
+	while (low < high)	{
+		uint8_t middle = (low + high) / 2;
+		uint16_t middleSource = pgm_read_word(&sources[middle]);
+		if (middleSource == source) return middle;
+		if (middleSource < source) low = middle + 1;
+		else high = middle;
 	}
+	return sourcesLength;
 }
-		
+
+/*
+ * Translating a video source to an index. Unknown sources give 0 (Black)
+ */
+uint8_t ATEMbase::getVideoSrcIndex(uint16_t videoSrc)	{
+	if (videoSrc <= ATEM_videoInputCount) return videoSrc;
+
+	uint8_t index = _findSourceIndex(ATEM_videoSources, ATEM_videoSourceCount, videoSrc);
+	return index < ATEM_videoSourceCount ? index : 0;
+}
+
+/*
+ * Translating an audio source to an index. Unknown sources give 0 (Input 1)
+ */
 uint8_t ATEMbase::getAudioSrcIndex(uint16_t audioSrc)	{
-	switch(audioSrc){
-		case 1:  // Input 1
-			return 0;
-		case 2:  // Input 2
-			return 1;
-		case 3:  // Input 3
-			return 2;
-		case 4:  // Input 4
-			return 3;
-		case 5:  // Input 5
-			return 4;
-		case 6:  // Input 6
-			return 5;
-		case 7:  // Input 7
-			return 6;
-		case 8:  // Input 8
-			return 7;
-		case 9:  // Input 9
-			return 8;
-		case 10:  // Input 10
-			return 9;
-		case 11:  // Input 11
-			return 10;
-		case 12:  // Input 12
-			return 11;
-		case 13:  // Input 13
-			return 12;
-		case 14:  // Input 14
-			return 13;
-		case 15:  // Input 15
-			return 14;
-		case 16:  // Input 16
-			return 15;
-		case 17:  // Input 17
-			return 16;
-		case 18:  // Input 18
-			return 17;
-		case 19:  // Input 19
-			return 18;
-		case 20:  // Input 20
-			return 19;
-		case 1001:  // XLR
-			return 20;
-		case 1101:  // AES/EBU
-			return 21;
-		case 1201:  // RCA
-			return 22;
-		case 2001:  // MP1
-			return 23;
-		case 2002:  // MP2
-			return 24;
-		default:
-			return 0;
-	}
+	if (audioSrc >= 1 && audioSrc <= ATEM_audioInputCount) return audioSrc-1;
+
+	uint8_t index = _findSourceIndex(ATEM_audioSources, ATEM_audioSourceCount, audioSrc);
+	return index < ATEM_audioSourceCount ? index : 0;
 }
 
 /*
  * Translating a index to a video source
  */
 uint16_t ATEMbase::getVideoIndexSrc(uint8_t index)	{
-  switch (index) {
-    case 0:  // Black
-      return 0;
-    case 1:  // Input 1
-      return 1;
-    case 2:  // Input 2
-      return 2;
-    case 3:  // Input 3
-      return 3;
-    case 4:  // Input 4
-      return 4;
-    case 5:  // Input 5
-      return 5;
-    case 6:  // Input 6
-      return 6;
-    case 7:  // Input 7
-      return 7;
-    case 8:  // Input 8
-      return 8;
-    case 9:  // Input 9
-      return 9;
-    case 10:  // Input 10
-      return 10;
-    case 11:  // Input 11
-      return 11;
-    case 12:  // Input 12
-      return 12;
-    case 13:  // Input 13
-      return 13;
-    case 14:  // Input 14
-      return 14;
-    case 15:  // Input 15
-      return 15;
-    case 16:  // Input 16
-      return 16;
-    case 17:  // Input 17
-      return 17;
-    case 18:  // Input 18
-      return 18;
-    case 19:  // Input 19
-      return 19;
-    case 20:  // Input 20
-      return 20;
-    case 21:  // Color Bars
-      return 1000;
-    case 22:  // Color 1
-      return 2001;
-    case 23:  // Color 2
-      return 2002;
-    case 24:  // Media Player 1
-      return 3010;
-    case 25:  // Media Player 1 Key
-      return 3011;
-    case 26:  // Media Player 2
-      return 3020;
-    case 27:  // Media Player 2 Key
-      return 3021;
-    case 28:  // Key 1 Mask
-      return 4010;
-    case 29:  // Key 2 Mask
-      return 4020;
-    case 30:  // Key 3 Mask
-      return 4030;
-    case 31:  // Key 4 Mask
-      return 4040;
-    case 32:  // DSK 1 Mask
-      return 5010;
-    case 33:  // DSK 2 Mask
-      return 5020;
-    case 34:  // Super Source
-      return 6000;
-    case 35:  // Clean Feed 1
-      return 7001;
-    case 36:  // Clean Feed 2
-      return 7002;
-    case 37:  // Auxilary 1
-      return 8001;
-    case 38:  // Auxilary 2
-      return 8002;
-    case 39:  // Auxilary 3
-      return 8003;
-    case 40:  // Auxilary 4
-      return 8004;
-    case 41:  // Auxilary 5
-      return 8005;
-    case 42:  // Auxilary 6
-      return 8006;
-    case 43:  // ME 1 Prog
-      return 10010;
-    case 44:  // ME 1 Prev
-      return 10011;
-    case 45:  // ME 2 Prog
-      return 10020;
-    case 46:  // ME 2 Prev
-      return 10021;
-    default:
-      return 0;
-  }
+	return index < ATEM_videoSourceCount ? pgm_read_word(&ATEM_videoSources[index]) : 0;
 }
 
 /*
  * Translating a index to a audio source
  */
 uint16_t ATEMbase::getAudioIndexSrc(uint8_t index)	{
-  switch (index) {
-    case 0:  // Input 1
-      return 1;
-    case 1:  // Input 2
-      return 2;
-    case 2:  // Input 3
-      return 3;
-    case 3:  // Input 4
-      return 4;
-    case 4:  // Input 5
-      return 5;
-    case 5:  // Input 6
-      return 6;
-    case 6:  // Input 7
-      return 7;
-    case 7:  // Input 8
-      return 8;
-    case 8:  // Input 9
-      return 9;
-    case 9:  // Input 10
-      return 10;
-    case 10:  // Input 11
-      return 11;
-    case 11:  // Input 12
-      return 12;
-    case 12:  // Input 13
-      return 13;
-    case 13:  // Input 14
-      return 14;
-    case 14:  // Input 15
-      return 15;
-    case 15:  // Input 16
-      return 16;
-    case 16:  // Input 17
-      return 17;
-    case 17:  // Input 18
-      return 18;
-    case 18:  // Input 19
-      return 19;
-    case 19:  // Input 20
-      return 20;
-    case 20:  // XLR
-      return 1001;
-    case 21:  // AES/EBU
-      return 1101;
-    case 22:  // RCA
-      return 1201;
-    case 23:  // MP1
-      return 2001;
-    case 24:  // MP2
-      return 2002;
-    default:
-      return 0;
-  }
+	return index < ATEM_audioSourceCount ? pgm_read_word(&ATEM_audioSources[index]) : 0;
 }
 
 uint8_t ATEMbase::maxAtemSeriesVideoInputs()	{
-	return 47;	// For the largest ATEM switcher, this is the number of video inputs. The max "index" number from the list above
+	return ATEM_videoSourceCount;	// For the largest ATEM switcher, this is the number of video sources. One more than the max "index" number
+}
+
+/*
+ * Number of audio sources, one more than the max "index" number
+ */
+uint8_t ATEMbase::maxAtemSeriesAudioInputs()	{
+	return ATEM_audioSourceCount;
 }
 
 
+/**
+ * Starts bundling commands: the set-commands called until commandBundleEnd() are sent together, in as few datagrams as possible.
+ * A bundle longer than ATEM_packetBufferLength is split over several datagrams, each taking a place in the retransmit window
+ * (see getCommandWindowSpace()).
+ */
 void ATEMbase::commandBundleStart()	{
 	resetCommandBundle();
 	_wipeCleanPacketBuffer();
+	_returnPacketLength = 0;
+	_bundleOverrun = false;
 	_cBundle = true;
 }
-void ATEMbase::commandBundleEnd()	{
+/**
+ * Sends what's left of the bundle. Returns false if the bundle had to push unacknowledged command packets out of the retransmit window,
+ * meaning they won't be retransmitted if lost. Bundles should then be smaller, or wait for getCommandWindowSpace() to go up.
+ */
+bool ATEMbase::commandBundleEnd()	{
 	if (_cBundle && _returnPacketLength > 0)	{
 
-  	  _createCommandHeader(ATEM_headerCmd_AckRequest, _returnPacketLength);
-  	  _sendPacketBuffer(_returnPacketLength);
+  	  if (!_sendCommandPacket(_returnPacketLength))	{
+		  _bundleOverrun = true;
+	  }
   	  _returnPacketLength = 0;
 	}
 	resetCommandBundle();
+	return !_bundleOverrun;
 }
 void ATEMbase::resetCommandBundle()	{
 	_cBundle = false;
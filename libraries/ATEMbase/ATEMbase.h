@@ -32,13 +32,10 @@ you can keep a clear conscience: http://skaarhoj.com/about/licenses/
 
 #include "Arduino.h"
 
-#if defined ESP8266 || defined ESP32
-#include <WiFiUdp.h>
-#else
-#include <EthernetUdp.h>
-#endif
-
+#include <UdpTransport.h>
 #include <SkaarhojPgmspace.h>
+#include "ATEMcapture.h"
+#include "ATEMcommandCache.h"
 
 #define ATEM_headerCmd_AckRequest 0x1	// Please acknowledge reception of this package...
 #define ATEM_headerCmd_HelloPacket 0x2	
@@ -46,60 +43,253 @@ you can keep a clear conscience: http://skaarhoj.com/about/licenses/
 #define ATEM_headerCmd_RequestNextAfter 0x8	// I'm requesting you to resend something to me.
 #define ATEM_headerCmd_Ack 0x10		// This package is an acknowledge to package id (byte 4-5) ATEM_headerCmd_AckRequest
 
-#define ATEM_maxInitPackageCount 40		// The maximum number of initialization packages. By observation on a 2M/E 4K can be up to (not fixed!) 32. We allocate a f more then...
-#define ATEM_packetBufferLength 96		// Size of packet buffer
+#define ATEM_tallyServerFeatureTallyDelta 0x1	// Applies the TlDl tally deltas of a TallyServer. See _tallyServerFeatures
+#define ATEM_tallyDeltaFullState 0x1		// Flag of a TlDl stamping the TlIn before it with its sequence, instead of carrying changes
+#define ATEM_tallySubscriptionLength 7	// Bytes of the bitmask of tally indexes subscribed to from a TallyServer, so indexes up to 55 can be
+
+// Buffer sizes and limits. They can be overridden per build without editing this file, e.g. with "-D ATEM_maxInitPackageCount=128" in build_flags of platformio.ini
+#ifndef ATEM_maxInitPackageCount
+#define ATEM_maxInitPackageCount 40		// The expected number of initialization packages. By observation on a 2M/E 4K can be up to (not fixed!) 32. We allocate a f more then... The bitmap tracking them grows if the switcher sends more.
+#endif
+#ifndef ATEM_initPackageLimit
+#define ATEM_initPackageLimit 1024		// Most initialization packages the bitmap grows to track (1 bit each), so a packet with a bogus packet ID can't make it allocate up to 4 KB. Ones after it are still parsed, but not asked for again if missed.
+#endif
+#ifndef ATEM_packetBufferLength
+#define ATEM_packetBufferLength 96		// Size of packet buffer, used for outgoing packets. Must fit the longest single command. Longer command bundles are split over several datagrams.
+#endif
+#ifndef ATEM_receiveBufferLength
+#define ATEM_receiveBufferLength 1500	// Size of receive buffer. Holds a whole datagram from the switcher, which by observation is up to about 1.4 KB during the initialization.
+#endif
+
+#ifndef ATEM_outgoingWindowSize
+#define ATEM_outgoingWindowSize 4		// Number of sent command packets kept for retransmission until the switcher acknowledges them, and as history for resend requests from the switcher. Must be a power of 2
+#endif
+#ifndef ATEM_maxRetransmits
+#define ATEM_maxRetransmits 10			// Number of times a command packet is retransmitted before giving up on it
+#endif
+#ifndef ATEM_initRecoveryDepth
+#define ATEM_initRecoveryDepth 4		// Number of missed initialization packages asked for at the same time
+#endif
+#ifndef ATEM_connectionTimeout
+#define ATEM_connectionTimeout 2500		// Time (ms) without anything from the switcher before the connection is considered lost
+#endif
+#ifndef ATEM_probeInterval
+#define ATEM_probeInterval 1000			// Time (ms) without anything from the switcher before we ask it for an acknowledge, to find out if it's still there
+#endif
+#ifndef ATEM_reconnectBackoffMin
+#define ATEM_reconnectBackoffMin 100	// Wait (ms) before the first reconnect attempt. Doubled for every failed attempt
+#endif
+#ifndef ATEM_reconnectBackoffMax
+#define ATEM_reconnectBackoffMax 4000	// Upper bound of the wait (ms) between reconnect attempts
+#endif
+#ifndef ATEM_reorderWindow
+#define ATEM_reorderWindow 4			// Number of packets from the switcher held back while waiting for an earlier one that is missing, so state is applied in order. Must be a power of 2
+#endif
+#ifndef ATEM_reorderSlotLength
+#define ATEM_reorderSlotLength 256		// Longest packet (bytes) that can be held back. Longer ones are applied right away, giving up on the missing ones before them
+#endif
+#ifndef ATEM_reorderTimeout
+#define ATEM_reorderTimeout 50			// Time (ms) a packet is held back before the missing ones before it are given up on, until the round trip time is measured. After that it's the retransmit timeout
+#endif
+#ifndef ATEM_tallyStateRequestInterval
+#define ATEM_tallyStateRequestInterval 500	// Time (ms) before asking a TallyServer for the whole tally state again, if it hasn't arrived
+#endif
+#ifndef ATEM_histogramBuckets
+#define ATEM_histogramBuckets 20		// Number of log2 buckets in latency histograms. 20 covers up to about half a second in microseconds
+#endif
+#define ATEM_initialRetransmitTimeout 200	// Retransmit timeout (ms) until the round trip time has been measured
+#define ATEM_minRetransmitTimeout 20		// Lower bound of the retransmit timeout (ms)
+#define ATEM_maxRetransmitTimeout 1000		// Upper bound of the retransmit timeout (ms)
+
+static_assert(ATEM_packetBufferLength >= 32, "ATEM_packetBufferLength must at least fit a header and one small command");
+static_assert(ATEM_receiveBufferLength >= 20, "ATEM_receiveBufferLength must at least fit a hello packet");
+static_assert(ATEM_maxInitPackageCount < 1<<15, "ATEM_maxInitPackageCount must be below the packet ID range");
+static_assert(ATEM_initPackageLimit >= ATEM_maxInitPackageCount && ATEM_initPackageLimit <= 1<<15, "ATEM_initPackageLimit must be between ATEM_maxInitPackageCount and the packet ID range");
+static_assert(ATEM_outgoingWindowSize >= 1 && (ATEM_outgoingWindowSize & (ATEM_outgoingWindowSize-1)) == 0, "ATEM_outgoingWindowSize must be a power of 2, so packet IDs map to the same slots across the wrap at 1<<15");
+static_assert(ATEM_initRecoveryDepth >= 1, "ATEM_initRecoveryDepth must allow at least one request");
+static_assert(ATEM_reorderWindow >= 1 && ATEM_reorderWindow <= 32 && (ATEM_reorderWindow & (ATEM_reorderWindow-1)) == 0, "ATEM_reorderWindow must be a power of 2 between 1 and 32, so packet IDs map to the same slots across the wrap at 1<<15");
+static_assert(ATEM_reorderSlotLength >= 12, "ATEM_reorderSlotLength must at least fit a header");
+static_assert(ATEM_histogramBuckets >= 2 && ATEM_histogramBuckets <= 32, "ATEM_histogramBuckets must be between 2 and 32");
+
+// Connection phases, see getConnectionPhase()
+#define ATEM_phaseIdle 0				// Not connected yet
+#define ATEM_phaseConnecting 1			// Hello packet sent, waiting for the switcher to answer
+#define ATEM_phaseInitializing 2		// Session established, receiving the initial state of the switcher
+#define ATEM_phaseConnected 3			// All of the initial state has been received
+#define ATEM_phaseReconnectWait 4		// Connection lost or not answered, waiting before trying again
 
 #define ATEM_debug 0				// If "1" (true), more debugging information may hit the serial monitor, in particular when _serialDebug = 0x80. Setting this to "0" is recommended for production environments since it saves on flash memory.
 
-#define ATEM_maxPacketId 1<<15	// ATEM wraps ID at bit 15, not 16
+#define ATEM_maxPacketId (1<<15)	// ATEM wraps ID at bit 15, not 16
+
+#define ATEM_fourCC(a,b,c,d) (((uint32_t)(uint8_t)(a)<<24) | ((uint32_t)(uint8_t)(b)<<16) | ((uint32_t)(uint8_t)(c)<<8) | (uint32_t)(uint8_t)(d))	// 4 char command name as an integer, as it's laid out in the packet. Usable as a case label.
+
+// Histogram of times in microseconds. buckets[0] counts 0, buckets[i] counts 2^(i-1) to 2^i-1, and the last bucket everything above
+struct ATEMhistogram {
+	uint32_t buckets[ATEM_histogramBuckets];
+	uint32_t count;						// Number of samples
+	uint32_t max;						// Largest sample
+	uint64_t sum;						// Sum of all samples, for the mean
+};
+
+// Latency measurements, see ATEMbase::getLatencyStats()
+struct ATEMlatencyStats {
+	ATEMhistogram ackRoundTrip;			// From sending a command packet until the switcher acknowledged it. Retransmitted packets are left out.
+	ATEMhistogram ackJitter;			// Difference between consecutive round trip samples
+	ATEMhistogram processing;			// From reading a datagram until it has been parsed
+};
+
+// What a call to ATEMbase::runLoopBounded() did
+struct ATEMrunLoopResult {
+	uint16_t packetsProcessed;			// Number of datagrams handled
+	bool morePending;					// The budget ran out before the UDP buffer was empty, so there may be more to handle
+};
 
 class ATEMbase
 {
+	friend class ATEMgroup;			// Hands datagrams from a shared socket to _receiveDatagram()
+
   protected:
-  	#if defined ESP8266 || defined ESP32
-  	WiFiUDP _Udp;
-  	#else
-	EthernetUDP _Udp;					// UDP object for communication, see constructor.
-	#endif
+	DefaultUdpTransport _defaultTransport;	// UDP of the board (or a POSIX socket on a host), used unless setTransport() is called
+	UdpTransport *_transport;			// UDP object for communication
 	uint16_t _localPort; 				// Default local port to send from. Preferably it's chosen randomly inside the class.
+	uint16_t _udpPort;					// Local port the UDP socket is bound to
+	uint16_t _fixedLocalPort;			// Local port used for every connect, also reconnecting, 0 for a random one. See setFixedLocalPort()
+	bool _udpStarted;					// Set if the UDP socket is open
+	bool _udpHadSession;				// Set if the switcher has answered a hello packet on the open UDP socket
 	IPAddress _switcherIP;				// IP address of the switcher
 	uint8_t _serialOutput;				// If set, the library will print status/debug information to the Serial object
 
 	// ATEM Connection Basics
 	uint16_t _localPacketIdCounter;  	// This is our counter for the command packages we might like to send to ATEM
 	boolean _initPayloadSent;  			// If true, the initial reception of the ATEM memory has passed and we can begin to respond during the runLoop()
-	uint8_t _initPayloadSentAtPacketId;	// The Remote Package ID at which point the initialization payload was completed.
+	uint16_t _initPayloadSentAtPacketId;	// The Remote Package ID at which point the initialization payload was completed.
 	boolean _hasInitialized;  			// If true, all initial payload packets has been received during requests for resent - and we are completely ready to rock!
 	boolean _isConnected;				// Set true if we have received a hello package from the switcher.
 	boolean _isRejected;				// Set true if the conencteion was rejected in hello package (due to connection limit).
 	uint16_t _sessionID;				// Session id of session, given by ATEM switcher
 	unsigned long _lastContact;			// Last time (millis) the switcher sent a packet to us.
 	uint16_t _lastRemotePacketID;		// The most recent Remote Packet Id from switcher
-	uint8_t _missedInitializationPackages[(ATEM_maxInitPackageCount+7)/8];	// Used to track which initialization packages have been missed
-	uint8_t _returnPacketLength;	
+	uint8_t *_missedInitializationPackages;	// Bitmap used to track which initialization packages have been missed. Grows if the initialization is longer than ATEM_maxInitPackageCount
+	uint16_t _missedInitializationPackagesLength;	// Size of _missedInitializationPackages in bytes
+	uint16_t _returnPacketLength;	
 	
-	// ATEM Buffer:
-	uint8_t _packetBuffer[ATEM_packetBufferLength];   		// Buffer for storing segments of the packets from ATEM and creating answer packets.
+	// ATEM Buffers:
+	uint8_t _packetBuffer[ATEM_packetBufferLength];   		// Buffer for creating answer and command packets.
+	static uint8_t _receiveBuffer[ATEM_receiveBufferLength];	// Buffer holding the whole datagram most recently received from an ATEM. Commands are parsed in place from here. Shared by all clients, as a datagram is done with before the next is read
 
 	uint16_t _cmdLength;				// Used when parsing packets
-	uint16_t _cmdPointer;				// Used when parsing packets
+
+	const uint32_t *_commandFilter;		// Allow-list of commands (ATEM_fourCC) to hand to _parseGetCommands(). NULL means all commands.
+	uint8_t _commandFilterLength;		// Number of commands in _commandFilter
+	unsigned long _parsedCommands;		// Number of commands handed to _parseGetCommands()
+	unsigned long _skippedCommands;		// Number of commands skipped because they were not in _commandFilter
+	ATEMcommandCache *_commandCache;	// Gets the payload of every command received, if set
 
 	bool _cBundle;				// If set, we are building a set-command bundle.
-	uint8_t _cBBO;		// Bundle Buffer Offset; This is an offset if you want to add more commands.
+	uint16_t _cBBO;		// Bundle Buffer Offset; This is an offset if you want to add more commands.
+	bool _bundleOverrun;		// Set if the current bundle pushed unacknowledged command packets out of the retransmit window
+	unsigned long _bundleSplits;	// Number of times a bundle was split over several datagrams
 
 	uint8_t _ATEMmodel;
 
 	bool neverConnected;
-	bool waitingForIncoming;
+
+	// Missed initialization packages we have asked the ATEM to resend, and are waiting for.
+	struct InitPackageRequest {
+		uint16_t _packetId;				// 0 if the slot is free
+		unsigned long _requestedAt;		// Time (millis) the request was sent
+	};
+	InitPackageRequest _initPackageRequests[ATEM_initRecoveryDepth];
+	unsigned long _initPackageRequestCount;	// Number of resend requests for missed initialization packages
+	unsigned long _connectedAt;			// Time (millis) of the latest connect()
+
+	bool _ackCoalescing;				// If set, packets from the ATEM are acknowledged once per runLoop() instead of one by one
+	bool _ackPending;					// A coalesced acknowledge is due
+	uint16_t _remoteContiguousPacketId;	// Highest remote packet ID up to which all packets have been parsed, which is what's acknowledged
+	uint32_t _remoteAppliedAhead;		// Packets parsed after _remoteContiguousPacketId, bit 0 being _remoteContiguousPacketId+1
+	unsigned long _ackRequests;			// Number of packets the ATEM asked us to acknowledge this session
+	unsigned long _acksSent;			// Number of acknowledges sent to the ATEM this session
+	unsigned long _initDuration;		// Time (ms) from connect() until all initialization packages were received
+
+	// Packets from the ATEM that arrived ahead of a missing one, held back until it arrives so they are applied in order.
+	// Indexed by packet ID modulo the window size.
+	struct HeldPacket {
+		uint16_t _packetId;
+		uint16_t _length;				// 0 if the slot is free
+		unsigned long _heldAt;			// Time (millis) the packet arrived
+		uint8_t _data[ATEM_reorderSlotLength];
+	};
+	HeldPacket _heldPackets[ATEM_reorderWindow];
+	uint16_t _remoteNextPacketId;		// Remote packet ID to apply next. During the initialization the one after the highest initialization package received
+	unsigned long _reorderedPackets;	// Number of packets held back because they arrived ahead of a missing one
+	unsigned long _duplicatePackets;	// Number of packets dropped because they were applied already
+	unsigned long _skippedGaps;			// Number of times missing packets were given up on
+	unsigned long _latePackets;			// Number of packets parsed after they had been given up on, arriving late
+	unsigned long _skippedPacketRequestedAt;	// Time (millis) the first packet given up on was last asked for
+
+	uint16_t _fanOutSequence;			// Sequence of the latest fan-out datagram parsed, 0 if none yet. See _handleFanOut()
+	unsigned long _fanOutPackets;		// Number of fan-out datagrams parsed
+	uint8_t _tallyServerFeatures;		// ATEM_tallyServerFeature* bits told to a TallyServer when acknowledging its hello, so it only sends what's understood
+	uint8_t _tallySubscription[ATEM_tallySubscriptionLength];	// Bitmask of the tally indexes wanted from a TallyServer, told along with _tallyServerFeatures. None set means all
+	bool _isTallyServer;				// Connected to a TallyServer rather than a switcher, as told by its hello
+	bool _tallyStateWanted;				// Set by subclasses after missing a tally delta, until the whole tally state has arrived. See _requestTallyState()
+	unsigned long _tallyStateRequestedAt;	// Time (millis) TlRq was last sent, 0 if not yet sent for _tallyStateWanted
+
+	uint8_t _connectionPhase;			// One of the ATEM_phase* values
+	uint16_t _connectionTimeout;		// Time (ms) of silence before the connection is considered lost
+	uint16_t _probeInterval;			// Time (ms) of silence before probing the switcher
+	unsigned long _lastProbeAt;			// Time (millis) the latest probe was sent
+	uint16_t _reconnectBackoff;			// Wait (ms) before the next reconnect attempt, before jitter
+	uint16_t _reconnectWait;			// Wait (ms) before the pending reconnect attempt, with jitter
+	unsigned long _reconnectWaitStartedAt;	// Time (millis) the connection phase became ATEM_phaseReconnectWait
+	unsigned long _lostAt;				// Time (millis) of the last contact before the connection was lost, 0 if not lost
+	unsigned long _lastReconnectDuration;	// Time (ms) from the last contact before the latest loss until initialized again
+	unsigned long _reconnects;			// Number of times the connection was lost and established again
+
+	// Command packets sent to the ATEM, kept so they can be retransmitted until acknowledged, and resent if the ATEM asks for them later.
+	// Indexed by packet ID modulo the window size.
+	struct CommandPacket {
+		bool _inFlight;					// Sent but not acknowledged yet
+		uint16_t _packetId;
+		uint16_t _length;				// 0 if the slot holds no packet
+		uint8_t _retransmits;			// Number of retransmissions so far
+		unsigned long _sentAt;			// Time (millis) of the first transmission
+		unsigned long _lastSentAt;		// Time (millis) of the latest (re)transmission
+		unsigned long _sentAtMicros;	// Time (micros) of the first transmission, for latency stats
+		uint16_t _timeout;				// Retransmit timeout (ms), doubled on every retransmission
+		uint8_t _data[ATEM_packetBufferLength];
+	};
+	CommandPacket _commandPackets[ATEM_outgoingWindowSize];
+
+	uint16_t _srtt8;					// Smoothed round trip time (ms) scaled by 8, 0 when not measured yet
+	uint16_t _rttvar4;					// Round trip time variation (ms) scaled by 4
+	uint16_t _retransmitTimeout;		// Current retransmit timeout (ms) for new command packets
+	uint16_t _lastAckedPacketId;		// ID of the latest acknowledged command packet
+	uint16_t _lastAckLatency;			// Time (ms) from sending to acknowledge of the latest acknowledged command packet
+	unsigned long _commandRetransmits;	// Number of command packet retransmissions
+	unsigned long _commandsLost;		// Number of command packets given up on after ATEM_maxRetransmits
+	unsigned long _resendRequestsServed;	// Number of resend requests from the ATEM answered from the command packet history
+	unsigned long _resendRequestsMissed;	// Number of resend requests from the ATEM for packets not in the history
+
+	ATEMrecorder *_recorder;			// Gets every datagram sent and received, if set
+	bool _replaying;					// Set when fed by replayDatagram(). Nothing is sent on the network then.
+
+	ATEMlatencyStats _latencyStats;
+	unsigned long _lastAckRoundTrip;	// Latest round trip sample (us), for the jitter
 	
   public:
     ATEMbase();
+    virtual ~ATEMbase();
 	void begin(const IPAddress ip);
 	void begin(const IPAddress ip, const uint16_t localPort);
+	void begin(const IPAddress ip, const uint32_t *commandFilter, const uint8_t commandFilterLength);
+	void setTransport(UdpTransport *transport);
     void connect();
     void connect(const boolean useFixedPortNumber);
     void runLoop();
 	void runLoop(uint16_t delayTime);
+	ATEMrunLoopResult runLoopBounded(uint16_t maxPackets, unsigned long maxMicros);
 		
 	uint16_t getATEM_lastRemotePacketId();
 	uint16_t getSessionID();
@@ -108,6 +298,43 @@ class ATEMbase
 	bool hasInitialized();
 	bool isRejected();
 
+	uint16_t getLastAckedPacketId();
+	uint16_t getLastAckLatency();
+	uint16_t getRoundTripTime();
+	uint16_t getRetransmitTimeout();
+	unsigned long getCommandRetransmitCount();
+	unsigned long getCommandsLostCount();
+	uint8_t getCommandWindowSpace();
+	unsigned long getCommandBundleSplitCount();
+	unsigned long getResendRequestsServedCount();
+	unsigned long getResendRequestsMissedCount();
+	unsigned long getInitDuration();
+	unsigned long getInitPackageRequestCount();
+
+	void setConnectionTimeouts(uint16_t probeInterval, uint16_t connectionTimeout);
+	void setFixedLocalPort(uint16_t port);
+	uint8_t getConnectionPhase();
+	unsigned long getLastReconnectDuration();
+	unsigned long getReconnectCount();
+
+	const ATEMlatencyStats &getLatencyStats();
+	void resetLatencyStats();
+
+	void setRecorder(ATEMrecorder *recorder);
+	void replayDatagram(const uint8_t *data, uint16_t length);
+
+	void setCommandFilter(const uint32_t *commandFilter, const uint8_t commandFilterLength);
+	void setCommandCache(ATEMcommandCache *commandCache);
+	void setAckCoalescing(bool enable);
+	unsigned long getAcksSavedCount();
+	unsigned long getParsedCommandCount();
+	unsigned long getSkippedCommandCount();
+	unsigned long getReorderedPacketCount();
+	unsigned long getDuplicatePacketCount();
+	unsigned long getSkippedGapCount();
+	unsigned long getLatePacketCount();
+	unsigned long getFanOutPacketCount();
+
   	void serialOutput(uint8_t level);
 	bool hasTimedOut(unsigned long time, unsigned long timeout);
 
@@ -121,9 +348,10 @@ class ATEMbase
 	uint16_t getAudioIndexSrc(uint8_t index);
 	
 	uint8_t maxAtemSeriesVideoInputs();
+	uint8_t maxAtemSeriesAudioInputs();
 		
 	void commandBundleStart();
-	void commandBundleEnd();
+	bool commandBundleEnd();
 	void resetCommandBundle();
 	
 	uint8_t getATEMmodel();
@@ -131,15 +359,49 @@ class ATEMbase
   protected:
   	void _createCommandHeader(const uint8_t headerCmd, const uint16_t lengthOfData);
   	void _createCommandHeader(const uint8_t headerCmd, const uint16_t lengthOfData, const uint16_t remotePacketID);
-  	void _sendPacketBuffer(uint8_t length);
+  	void _sendPacketBuffer(uint16_t length);
+	void _sendDatagram(const uint8_t *data, uint16_t length);
 	void _wipeCleanPacketBuffer();
 
-	void _parsePacket(uint16_t packetLength);
-	virtual void _parseGetCommands(const char *cmdString);
-	bool _readToPacketBuffer();
-	bool _readToPacketBuffer(uint8_t maxBytes);
+	bool _receiveDatagram();
+	void _handleDatagram(uint16_t packetSize, uint16_t readLength, unsigned long receivedAt);
+	void _processDatagram(uint16_t packetSize, uint16_t readLength);
+	void _runConnectionTasks();
+	void _requestTallyState();
+	void _checkConnectionTimeout();
+	void _setConnectionPhase(uint8_t phase);
+
+	void _parsePacket(const uint8_t *packet, uint16_t packetLength);
+	virtual void _parseGetCommands(uint32_t cmd, const uint8_t *cmdData, uint16_t cmdDataLength);
+	bool _isSubscribed(uint32_t cmdName);
 	void _prepareCommandPacket(const char *cmdString, uint8_t cmdBytes, bool indexMatch=true);
 	void _finishCommandPacket();
+
+	bool _sendCommandPacket(uint16_t length);
+	void _handleAck(uint16_t ackedPacketId);
+	void _retransmitCommandPackets();
+	void _resendCommandPacket(CommandPacket *packet);
+	bool _resendCommandPacketsFrom(uint16_t packetId);
+	static bool _isPacketIdAfter(uint16_t packetId, uint16_t otherPacketId);
+	static uint8_t _findSourceIndex(const uint16_t *sources, uint8_t sourcesLength, uint16_t source);
+	static void _addToHistogram(ATEMhistogram *histogram, unsigned long value);
+
+	bool _resizeMissedInitializationPackages(uint16_t packetId);
+	bool _isInitializationPackageMissed(uint16_t packetId);
+	void _requestMissedInitializationPackages();
+
+	void _sequencePacket(uint8_t headerBitmask, uint16_t readLength, bool duplicate);
+	void _handleFanOut(uint16_t packetSize, uint16_t readLength);
+	void _skipToPacketId(uint16_t packetId);
+	void _applyHeldPackets();
+	void _releaseHeldPackets();
+	void _requestSkippedPacket();
+	uint16_t _reorderTimeout();
+	void _applyPacket(const uint8_t *packet, uint16_t length, uint16_t packetId);
+	bool _isRemotePacketApplied(uint16_t packetId);
+
+	void _markRemotePacketApplied(uint16_t packetId);
+	void _sendAck(uint16_t packetId);
 };
 
 #endif
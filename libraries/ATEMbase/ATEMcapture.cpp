@@ -0,0 +1,224 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the modified version of Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client library for Arduino.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ATEMcapture.h"
+#include "ATEMbase.h"
+
+static const uint8_t captureHeader[ATEM_captureHeaderLength] = {'A', 'T', 'C', 'P', ATEM_captureVersion, 0, 0, 0};
+
+/**
+ * Constructor, allocating size bytes for the ring buffer
+ */
+ATEMringRecorder::ATEMringRecorder(uint32_t size) {
+	_buffer = new uint8_t[size];
+	_size = _buffer != NULL ? size : 0;
+	clear();
+}
+
+ATEMringRecorder::~ATEMringRecorder() {
+	delete[] _buffer;
+}
+
+void ATEMringRecorder::clear() {
+	_head = 0;
+	_tail = 0;
+	_used = 0;
+	_records = 0;
+	_dropped = 0;
+}
+
+void ATEMringRecorder::_put(uint8_t value) {
+	_buffer[_head] = value;
+	_head = (_head + 1) % _size;
+	_used++;
+}
+
+uint8_t ATEMringRecorder::_get(uint32_t index) {
+	return _buffer[index % _size];
+}
+
+/**
+ * Stores the datagram, with the absolute time. It's turned into the time since the previous record by writeTo().
+ */
+void ATEMringRecorder::record(uint8_t direction, unsigned long timeMicros, const uint8_t *data, uint16_t length) {
+	uint32_t recordLength = ATEM_captureRecordHeaderLength + length;
+	if (recordLength > _size) return;
+
+	while (_size - _used < recordLength) {	// Drop the oldest records until there's room
+		uint32_t oldLength = ATEM_captureRecordHeaderLength + (_get(_tail + 5) | (_get(_tail + 6) << 8));
+		_tail = (_tail + oldLength) % _size;
+		_used -= oldLength;
+		_records--;
+		_dropped++;
+	}
+
+	for (uint8_t i = 0; i < 4; i++) _put(timeMicros >> (i * 8));
+	_put(direction);
+	_put(lowByte(length));
+	_put(highByte(length));
+	for (uint16_t i = 0; i < length; i++) _put(data[i]);
+	_records++;
+}
+
+/**
+ * Writes the recorded datagrams in the capture format. Returns the number of bytes written.
+ */
+size_t ATEMringRecorder::writeTo(Print &out) {
+	size_t written = out.write(captureHeader, ATEM_captureHeaderLength);
+
+	uint32_t index = _tail;
+	unsigned long lastTime = 0;
+	for (uint32_t r = 0; r < _records; r++) {
+		unsigned long time = 0;
+		for (uint8_t i = 0; i < 4; i++) time |= (unsigned long)_get(index + i) << (i * 8);
+		unsigned long delta = r == 0 ? 0 : time - lastTime;
+		lastTime = time;
+
+		uint8_t recordHeader[ATEM_captureRecordHeaderLength] = {(uint8_t)delta, (uint8_t)(delta >> 8), (uint8_t)(delta >> 16), (uint8_t)(delta >> 24), _get(index + 4), _get(index + 5), _get(index + 6)};
+		written += out.write(recordHeader, ATEM_captureRecordHeaderLength);
+
+		uint16_t length = recordHeader[5] | (recordHeader[6] << 8);
+		for (uint16_t i = 0; i < length; i++) written += out.write(_get(index + ATEM_captureRecordHeaderLength + i));
+		index = (index + ATEM_captureRecordHeaderLength + length) % _size;
+	}
+	return written;
+}
+
+uint32_t ATEMringRecorder::getRecordCount() {
+	return _records;
+}
+
+uint32_t ATEMringRecorder::getDroppedCount() {
+	return _dropped;
+}
+
+#ifndef ARDUINO
+ATEMfileRecorder::ATEMfileRecorder() {
+	_file = NULL;
+}
+
+ATEMfileRecorder::~ATEMfileRecorder() {
+	close();
+}
+
+/**
+ * Creates the capture file at path. Returns false if it couldn't be created.
+ */
+bool ATEMfileRecorder::open(const char *path) {
+	close();
+	_file = fopen(path, "wb");
+	if (_file == NULL) return false;
+
+	fwrite(captureHeader, 1, ATEM_captureHeaderLength, _file);
+	_first = true;
+	return true;
+}
+
+void ATEMfileRecorder::close() {
+	if (_file != NULL) {
+		fclose(_file);
+		_file = NULL;
+	}
+}
+
+void ATEMfileRecorder::record(uint8_t direction, unsigned long timeMicros, const uint8_t *data, uint16_t length) {
+	if (_file == NULL) return;
+
+	uint32_t delta = _first ? 0 : timeMicros - _lastTime;
+	_lastTime = timeMicros;
+	_first = false;
+
+	uint8_t recordHeader[ATEM_captureRecordHeaderLength] = {(uint8_t)delta, (uint8_t)(delta >> 8), (uint8_t)(delta >> 16), (uint8_t)(delta >> 24), direction, lowByte(length), highByte(length)};
+	fwrite(recordHeader, 1, ATEM_captureRecordHeaderLength, _file);
+	fwrite(data, 1, length, _file);
+}
+#endif
+
+/**
+ * Constructor. The capture is not copied, so it must stay valid while replaying.
+ */
+ATEMreplay::ATEMreplay(const uint8_t *capture, uint32_t length) {
+	_capture = capture;
+	_length = length;
+	rewind();
+}
+
+/**
+ * True if the capture starts with a header of a version we can read
+ */
+bool ATEMreplay::isValid() {
+	return _length >= ATEM_captureHeaderLength && memcmp(_capture, captureHeader, 5) == 0;
+}
+
+void ATEMreplay::rewind() {
+	_position = ATEM_captureHeaderLength;
+}
+
+/**
+ * Reads the next record. Returns false at the end of the capture, or if the record is cut off.
+ */
+bool ATEMreplay::next(uint8_t *direction, unsigned long *deltaMicros, const uint8_t **data, uint16_t *length) {
+	if (_position + ATEM_captureRecordHeaderLength > _length) return false;
+
+	const uint8_t *record = _capture + _position;
+	uint16_t recordLength = record[5] | (record[6] << 8);
+	if (_position + ATEM_captureRecordHeaderLength + recordLength > _length) return false;
+
+	*deltaMicros = (unsigned long)record[0] | ((unsigned long)record[1] << 8) | ((unsigned long)record[2] << 16) | ((unsigned long)record[3] << 24);
+	*direction = record[4];
+	*length = recordLength;
+	*data = record + ATEM_captureRecordHeaderLength;
+	_position += ATEM_captureRecordHeaderLength + recordLength;
+	return true;
+}
+
+/**
+ * Feeds the received datagrams of the capture to client with ATEMbase::replayDatagram(), from the start.
+ * If realTime is set, the recorded time between datagrams is kept. Otherwise they are fed as fast as possible.
+ */
+ATEMreplayResult ATEMreplay::run(ATEMbase &client, bool realTime) {
+	ATEMreplayResult result = {0, 0, 0, isValid()};
+	if (!result.valid) return result;
+
+	rewind();
+	unsigned long startTime = micros();
+	unsigned long dueTime = 0;	// Since startTime
+
+	uint8_t direction;
+	unsigned long delta;
+	const uint8_t *data;
+	uint16_t length;
+	while (next(&direction, &delta, &data, &length)) {
+		dueTime += delta;
+		if (direction != ATEM_captureIn) continue;
+
+		if (realTime) {
+			while ((unsigned long)(micros() - startTime) < dueTime) {
+				yield();
+			}
+		}
+		client.replayDatagram(data, length);
+		result.datagrams++;
+		result.bytes += length;
+	}
+	result.valid = _position == _length;
+	result.elapsedMicros = micros() - startTime;
+	return result;
+}
@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the modified version of Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client library for Arduino.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ATEMcapture_h
+#define ATEMcapture_h
+
+#include "Arduino.h"
+
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+/*
+Capture format, all numbers little endian:
+	File header (8 bytes): 'A' 'T' 'C' 'P', version, 3 reserved bytes
+	Records, one per datagram:
+		uint32	Time (us) since the previous record (0 for the first)
+		uint8	Direction, ATEM_captureIn or ATEM_captureOut
+		uint16	Length of the datagram
+		...		The datagram
+*/
+#define ATEM_captureVersion 1
+#define ATEM_captureHeaderLength 8
+#define ATEM_captureRecordHeaderLength 7
+
+#define ATEM_captureIn 0		// Datagram received from the switcher
+#define ATEM_captureOut 1		// Datagram sent to the switcher
+
+class ATEMbase;
+
+/**
+ * Gets every datagram ATEMbase sends and receives, see ATEMbase::setRecorder()
+ */
+class ATEMrecorder {
+  public:
+	virtual ~ATEMrecorder() {}
+	virtual void record(uint8_t direction, unsigned long timeMicros, const uint8_t *data, uint16_t length) = 0;
+};
+
+/**
+ * Keeps the latest datagrams in a ring buffer in RAM, dropping the oldest ones when full. For use on the device.
+ * writeTo() writes them in the capture format, for example to Serial.
+ */
+class ATEMringRecorder : public ATEMrecorder {
+  private:
+	uint8_t *_buffer;
+	uint32_t _size;
+	uint32_t _head;				// Where the next record is written
+	uint32_t _tail;				// Oldest record
+	uint32_t _used;				// Bytes in use
+	uint32_t _records;
+	uint32_t _dropped;			// Records dropped to make room
+
+	void _put(uint8_t value);
+	uint8_t _get(uint32_t index);
+
+  public:
+	ATEMringRecorder(uint32_t size);
+	~ATEMringRecorder();
+
+	void record(uint8_t direction, unsigned long timeMicros, const uint8_t *data, uint16_t length);
+	void clear();
+	size_t writeTo(Print &out);
+
+	uint32_t getRecordCount();
+	uint32_t getDroppedCount();
+};
+
+#ifndef ARDUINO
+/**
+ * Writes datagrams to a capture file. For use on a host.
+ */
+class ATEMfileRecorder : public ATEMrecorder {
+  private:
+	FILE *_file;
+	unsigned long _lastTime;
+	bool _first;
+
+  public:
+	ATEMfileRecorder();
+	~ATEMfileRecorder();
+
+	bool open(const char *path);
+	void close();
+	void record(uint8_t direction, unsigned long timeMicros, const uint8_t *data, uint16_t length);
+};
+#endif
+
+// What a call to ATEMreplay::run() did
+struct ATEMreplayResult {
+	uint32_t datagrams;			// Number of datagrams fed to the client
+	uint32_t bytes;				// Bytes in those datagrams
+	unsigned long elapsedMicros;	// Time it took
+	bool valid;					// False if the capture was malformed
+};
+
+/**
+ * Feeds the received datagrams of a capture to a client, in recorded time or as fast as possible.
+ * Datagrams the client sent during the recording are skipped - the client sends its own.
+ */
+class ATEMreplay {
+  private:
+	const uint8_t *_capture;
+	uint32_t _length;
+	uint32_t _position;
+
+  public:
+	ATEMreplay(const uint8_t *capture, uint32_t length);
+
+	bool isValid();
+	void rewind();
+	bool next(uint8_t *direction, unsigned long *deltaMicros, const uint8_t **data, uint16_t *length);
+	ATEMreplayResult run(ATEMbase &client, bool realTime);
+};
+
+#endif
@@ -0,0 +1,426 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the modified version of Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client library for Arduino.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ATEMcommandCache.h"
+#include "ATEMbase.h"
+
+struct ATEMindexLength {
+	uint32_t cmd;
+	uint8_t indexLength;		// Number of leading payload bytes making up the index
+};
+
+// Commands that exist once per M/E, keyer, source etc., and what their index is. In ascending order of ATEM_fourCC, for the binary search
+static constexpr ATEMindexLength ATEM_indexLengths[] PROGMEM = {
+	{ATEM_fourCC('A','M','I','P'), 2},	// Audio mixer input: source
+	{ATEM_fourCC('A','u','x','S'), 1},	// Aux source: channel
+	{ATEM_fourCC('C','o','l','V'), 1},	// Color generator
+	{ATEM_fourCC('D','s','k','B'), 1},	// DSK
+	{ATEM_fourCC('D','s','k','P'), 1},	// DSK
+	{ATEM_fourCC('D','s','k','S'), 1},	// DSK
+	{ATEM_fourCC('F','t','b','P'), 1},	// M/E
+	{ATEM_fourCC('F','t','b','S'), 1},	// M/E
+	{ATEM_fourCC('I','n','P','r'), 2},	// Input properties: source
+	{ATEM_fourCC('K','A','C','k'), 2},	// M/E, keyer
+	{ATEM_fourCC('K','K','F','P'), 2},	// M/E, keyer
+	{ATEM_fourCC('K','e','B','P'), 2},	// M/E, keyer
+	{ATEM_fourCC('K','e','D','V'), 2},	// M/E, keyer
+	{ATEM_fourCC('K','e','F','S'), 2},	// M/E, keyer
+	{ATEM_fourCC('K','e','L','m'), 2},	// M/E, keyer
+	{ATEM_fourCC('K','e','O','n'), 2},	// M/E, keyer
+	{ATEM_fourCC('K','e','P','t'), 2},	// M/E, keyer
+	{ATEM_fourCC('M','P','C','E'), 1},	// Media player
+	{ATEM_fourCC('M','P','r','p'), 2},	// Macro
+	{ATEM_fourCC('M','v','I','n'), 2},	// Multiviewer, window
+	{ATEM_fourCC('M','v','P','r'), 1},	// Multiviewer
+	{ATEM_fourCC('P','r','g','I'), 1},	// M/E
+	{ATEM_fourCC('P','r','v','I'), 1},	// M/E
+	{ATEM_fourCC('T','D','p','P'), 1},	// M/E
+	{ATEM_fourCC('T','D','v','P'), 1},	// M/E
+	{ATEM_fourCC('T','M','x','P'), 1},	// M/E
+	{ATEM_fourCC('T','S','t','P'), 1},	// M/E
+	{ATEM_fourCC('T','W','p','P'), 1},	// M/E
+	{ATEM_fourCC('T','r','P','r'), 1},	// M/E
+	{ATEM_fourCC('T','r','P','s'), 1},	// M/E
+	{ATEM_fourCC('T','r','S','S'), 1},	// M/E
+};
+#define ATEM_indexLengthCount (sizeof(ATEM_indexLengths)/sizeof(ATEM_indexLengths[0]))
+
+static constexpr bool ATEM_isAscending(const ATEMindexLength *commands, size_t length)	{
+	return length < 2 || (commands[0].cmd < commands[1].cmd && ATEM_isAscending(commands+1, length-1));
+}
+static_assert(ATEM_isAscending(ATEM_indexLengths, ATEM_indexLengthCount), "ATEM_indexLengths must be in ascending order for the binary search");
+
+/**
+ * Constructor, allocating arenaSize bytes for payloads and room for maxEntries commands
+ */
+ATEMcommandCache::ATEMcommandCache(uint16_t arenaSize, uint8_t maxEntries) {
+	_arena = new uint8_t[arenaSize];
+	_arenaSize = _arena != NULL ? arenaSize : 0;
+	_entries = new Entry[maxEntries];
+	_maxEntries = _entries != NULL ? maxEntries : 0;
+	_indexOverrideCount = 0;
+	clear();
+}
+
+ATEMcommandCache::~ATEMcommandCache() {
+	delete[] _arena;
+	delete[] _entries;
+}
+
+/**
+ * Forgets all commands, e.g. when a new session with the switcher starts. Index lengths set with setIndexLength() are kept.
+ */
+void ATEMcommandCache::clear() {
+	_arenaTop = 0;
+	_liveBytes = 0;
+	_entryCount = 0;
+	_clock = 0;
+	_stores = 0;
+	_evictions = 0;
+	_dropped = 0;
+}
+
+/**
+ * Tells how many leading payload bytes of cmd (made with ATEM_fourCC) make up its index, for commands the cache doesn't know,
+ * or to change it for one it does. 0 keeps only the latest one. Returns false if ATEM_commandCacheIndexOverrides is used up.
+ */
+bool ATEMcommandCache::setIndexLength(uint32_t cmd, uint8_t indexLength) {
+	uint8_t i = 0;
+	while (i < _indexOverrideCount && _indexOverrides[i]._cmd != cmd) i++;
+	if (i == ATEM_commandCacheIndexOverrides) return false;
+
+	_indexOverrides[i]._cmd = cmd;
+	_indexOverrides[i]._indexLength = indexLength <= 4 ? indexLength : 4;
+	if (i == _indexOverrideCount) _indexOverrideCount++;
+	return true;
+}
+
+uint8_t ATEMcommandCache::_indexLength(uint32_t cmd) {
+	for (uint8_t i = 0; i < _indexOverrideCount; i++) {
+		if (_indexOverrides[i]._cmd == cmd) return _indexOverrides[i]._indexLength;
+	}
+
+	uint8_t low = 0;
+	uint8_t high = ATEM_indexLengthCount;
+	while (low < high) {
+		uint8_t middle = (low + high) / 2;
+		uint32_t middleCmd = pgm_read_dword(&ATEM_indexLengths[middle].cmd);
+		if (middleCmd == cmd) return pgm_read_byte(&ATEM_indexLengths[middle].indexLength);
+		if (middleCmd < cmd) low = middle + 1;
+		else high = middle;
+	}
+	return 0;
+}
+
+/**
+ * Binary search for the entry of cmd and index. Sets position to where it is, or where it belongs if it's not there.
+ */
+bool ATEMcommandCache::_find(uint32_t cmd, uint32_t index, uint8_t *position) {
+	uint8_t low = 0;
+	uint8_t high = _entryCount;
+	while (low < high) {
+		uint8_t middle = (low + high) / 2;
+		const Entry &entry = _entries[middle];
+		if (entry._cmd == cmd && entry._index == index) {
+			*position = middle;
+			return true;
+		}
+		if (entry._cmd < cmd || (entry._cmd == cmd && entry._index < index)) low = middle + 1;
+		else high = middle;
+	}
+	*position = low;
+	return false;
+}
+
+/**
+ * Removes the entry at position. Its payload leaves a gap in the arena until _compact()
+ */
+void ATEMcommandCache::_remove(uint8_t position) {
+	_liveBytes -= _entries[position]._length;
+	memmove(&_entries[position], &_entries[position + 1], (_entryCount - position - 1) * sizeof(Entry));
+	_entryCount--;
+}
+
+/**
+ * Removes the least recently used entry
+ */
+void ATEMcommandCache::_evict() {
+	uint8_t oldest = 0;
+	for (uint8_t i = 1; i < _entryCount; i++) {
+		if (_entries[i]._lastUsed < _entries[oldest]._lastUsed) oldest = i;
+	}
+	_remove(oldest);
+	_evictions++;
+}
+
+/**
+ * Moves the payloads to the start of the arena, in the order they are in it, closing the gaps left by removed entries
+ */
+void ATEMcommandCache::_compact() {
+	uint16_t top = 0;
+	uint16_t lastOffset = 0;
+	int16_t lastPosition = -1;		// Entries up to this offset and position in _entries have been moved
+	while (true) {
+		int16_t next = -1;			// Entry with the lowest payload offset after those
+		for (uint8_t i = 0; i < _entryCount; i++) {
+			uint16_t offset = _entries[i]._offset;
+			bool notMoved = offset > lastOffset || (offset == lastOffset && i > lastPosition);
+			if (notMoved && (next < 0 || offset < _entries[next]._offset)) next = i;
+		}
+		if (next < 0) break;
+
+		Entry &entry = _entries[next];
+		lastOffset = entry._offset;
+		lastPosition = next;
+		memmove(_arena + top, _arena + entry._offset, entry._length);
+		entry._offset = top;
+		top += entry._length;
+	}
+	_arenaTop = top;
+}
+
+/**
+ * Keeps the payload of a command as received, see ATEMbase::setCommandCache(). cmd is made with ATEM_fourCC, cmdData and cmdDataLength as for _parseGetCommands()
+ */
+void ATEMcommandCache::store(uint32_t cmd, const uint8_t *cmdData, uint16_t cmdDataLength) {
+	uint8_t indexLength = _indexLength(cmd);
+	uint32_t index = 0;
+	for (uint8_t i = 0; i < indexLength && i < cmdDataLength; i++) {
+		index = (index << 8) | cmdData[i];
+	}
+
+	uint8_t position;
+	uint32_t lastUsed = _clock;
+	if (_find(cmd, index, &position)) {
+		Entry &entry = _entries[position];
+		if (entry._length == cmdDataLength) {	// The usual case, an update of the same length
+			memcpy(_arena + entry._offset, cmdData, cmdDataLength);
+			_stores++;
+			return;
+		}
+		lastUsed = entry._lastUsed;
+		_remove(position);
+	} else {
+		_clock++;
+		lastUsed = _clock;
+	}
+
+	if (cmdDataLength > _arenaSize || _maxEntries == 0) {
+		_dropped++;
+		return;
+	}
+	while (_entryCount >= _maxEntries || _liveBytes + cmdDataLength > _arenaSize) {
+		_evict();
+	}
+	if (_arenaTop + cmdDataLength > _arenaSize) {
+		_compact();
+	}
+
+	_find(cmd, index, &position);	// May have moved by removing entries
+	memmove(&_entries[position + 1], &_entries[position], (_entryCount - position) * sizeof(Entry));
+	_entryCount++;
+	Entry &entry = _entries[position];
+	entry._cmd = cmd;
+	entry._index = index;
+	entry._offset = _arenaTop;
+	entry._length = cmdDataLength;
+	entry._lastUsed = lastUsed;
+	memcpy(_arena + _arenaTop, cmdData, cmdDataLength);
+	_arenaTop += cmdDataLength;
+	_liveBytes += cmdDataLength;
+	_stores++;
+}
+
+/**
+ * Looks up the entry of cmd and index, counting it as used. NULL if not cached.
+ */
+const ATEMcommandCache::Entry *ATEMcommandCache::_use(uint32_t cmd, uint32_t index) {
+	uint8_t position;
+	if (!_find(cmd, index, &position)) return NULL;
+
+	_clock++;
+	_entries[position]._lastUsed = _clock;
+	return &_entries[position];
+}
+
+/**
+ * If the latest cmd (made with ATEM_fourCC) with this index is cached
+ */
+bool ATEMcommandCache::has(uint32_t cmd, uint32_t index) {
+	return _use(cmd, index) != NULL;
+}
+
+/**
+ * Payload of the latest cmd (made with ATEM_fourCC) with this index, after the 8 byte command header, and its length. NULL if not cached.
+ * It's only valid until the next datagram from the switcher is parsed.
+ */
+const uint8_t *ATEMcommandCache::get(uint32_t cmd, uint32_t index, uint16_t *length) {
+	const Entry *entry = _use(cmd, index);
+	if (entry == NULL) {
+		*length = 0;
+		return NULL;
+	}
+	*length = entry->_length;
+	return _arena + entry->_offset;
+}
+
+/**
+ * Byte at offset in the payload of cmd with this index. 0 if not cached or the payload is shorter.
+ */
+uint8_t ATEMcommandCache::getUInt8(uint32_t cmd, uint32_t index, uint16_t offset) {
+	uint16_t length;
+	const uint8_t *payload = get(cmd, index, &length);
+	return offset + 1 <= length ? payload[offset] : 0;
+}
+
+/**
+ * Big endian 16 bit value at offset in the payload of cmd with this index, as the switcher sends them. 0 if not cached or the payload is shorter.
+ */
+uint16_t ATEMcommandCache::getUInt16(uint32_t cmd, uint32_t index, uint16_t offset) {
+	uint16_t length;
+	const uint8_t *payload = get(cmd, index, &length);
+	return offset + 2 <= length ? word(payload[offset], payload[offset + 1]) : 0;
+}
+
+/**
+ * Big endian 32 bit value at offset in the payload of cmd with this index. 0 if not cached or the payload is shorter.
+ */
+uint32_t ATEMcommandCache::getUInt32(uint32_t cmd, uint32_t index, uint16_t offset) {
+	uint16_t length;
+	const uint8_t *payload = get(cmd, index, &length);
+	if (offset + 4 > length) return 0;
+	return ((uint32_t)payload[offset] << 24) | ((uint32_t)payload[offset + 1] << 16) | ((uint32_t)payload[offset + 2] << 8) | payload[offset + 3];
+}
+
+/**
+ * If the video mode (VidM) is cached
+ */
+bool ATEMcommandCache::hasVideoMode() {
+	return has(ATEM_fourCC('V','i','d','M'), 0);
+}
+
+/**
+ * Video mode of the switcher (VidM) as numbered in the protocol, e.g. 6 for 1080i50. 0 if not cached, which is also 525i59.94 NTSC, see hasVideoMode().
+ */
+uint8_t ATEMcommandCache::getVideoMode() {
+	return getUInt8(ATEM_fourCC('V','i','d','M'), 0, 0);
+}
+
+/**
+ * If the topology (_top) is cached
+ */
+bool ATEMcommandCache::hasTopology() {
+	return has(ATEM_fourCC('_','t','o','p'), 0);
+}
+
+/**
+ * Number of M/Es of the switcher (_top). 0 if not cached, as for the other topology getters, see hasTopology().
+ */
+uint8_t ATEMcommandCache::getTopologyMEs() {
+	return getUInt8(ATEM_fourCC('_','t','o','p'), 0, 0);
+}
+
+/**
+ * Number of video sources of the switcher (_top)
+ */
+uint8_t ATEMcommandCache::getTopologySources() {
+	return getUInt8(ATEM_fourCC('_','t','o','p'), 0, 1);
+}
+
+/**
+ * Number of aux outputs of the switcher (_top)
+ */
+uint8_t ATEMcommandCache::getTopologyAuxChannels() {
+	return getUInt8(ATEM_fourCC('_','t','o','p'), 0, 3);
+}
+
+/**
+ * Number of downstream keyers of the switcher (_top)
+ */
+uint8_t ATEMcommandCache::getTopologyDownstreamKeyers() {
+	return getUInt8(ATEM_fourCC('_','t','o','p'), 0, 4);
+}
+
+/**
+ * If the source of an aux output (AuxS) is cached, auxChannel 0 being the first
+ */
+bool ATEMcommandCache::hasAuxSource(uint8_t auxChannel) {
+	return has(ATEM_fourCC('A','u','x','S'), auxChannel);
+}
+
+/**
+ * Video source of an aux output (AuxS), auxChannel 0 being the first. 0 if not cached, which is also black, see hasAuxSource().
+ */
+uint16_t ATEMcommandCache::getAuxSource(uint8_t auxChannel) {
+	return getUInt16(ATEM_fourCC('A','u','x','S'), auxChannel, 2);
+}
+
+/**
+ * If the recording status (RTMS) is cached
+ */
+bool ATEMcommandCache::hasRecordingStatus() {
+	return has(ATEM_fourCC('R','T','M','S'), 0);
+}
+
+/**
+ * Raw recording status flags (RTMS): bit 0 is set while recording and bit 7 while stopping, the others tell errors. 0 if not cached, see hasRecordingStatus().
+ */
+uint16_t ATEMcommandCache::getRecordingStatusFlags() {
+	return getUInt16(ATEM_fourCC('R','T','M','S'), 0, 0);
+}
+
+/**
+ * If the switcher is recording (RTMS), including while it's stopping. False if not cached
+ */
+bool ATEMcommandCache::isRecording() {
+	return getRecordingStatusFlags() & (1 << 0 | 1 << 7);
+}
+
+uint8_t ATEMcommandCache::getEntryCount() {
+	return _entryCount;
+}
+
+/**
+ * Bytes of the arena holding payloads
+ */
+uint16_t ATEMcommandCache::getUsedBytes() {
+	return _liveBytes;
+}
+
+/**
+ * Number of commands stored since clear()
+ */
+unsigned long ATEMcommandCache::getStoreCount() {
+	return _stores;
+}
+
+/**
+ * Number of commands evicted to make room since clear()
+ */
+unsigned long ATEMcommandCache::getEvictionCount() {
+	return _evictions;
+}
+
+/**
+ * Number of commands not stored since clear(), because they were longer than the whole arena
+ */
+unsigned long ATEMcommandCache::getDroppedCount() {
+	return _dropped;
+}
@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the modified version of Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client library for Arduino.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ATEMcommandCache_h
+#define ATEMcommandCache_h
+
+#include "Arduino.h"
+
+#ifndef ATEM_commandCacheIndexOverrides
+#define ATEM_commandCacheIndexOverrides 8	// Number of commands setIndexLength() can be called for
+#endif
+
+/**
+ * Keeps the latest raw payload of every command the switcher sends, see ATEMbase::setCommandCache().
+ * Nothing is decoded when a command arrives, only copied. Values are read from the payload when asked for, so any state
+ * (e.g. VidM, _top or AuxS of all aux) can be queried without parse code for it.
+ *
+ * Commands that exist once per M/E, input, keyer etc. are told apart by their index: the value of their first payload bytes,
+ * big endian (e.g. the aux channel of AuxS, or the source of InPr). How many bytes that is is known for common commands,
+ * and can be set for others with setIndexLength(). Commands not known are kept once, the latest one winning.
+ *
+ * Memory is fixed when constructed: payloads share an arena of arenaSize bytes, and at most maxEntries commands are kept.
+ * When either runs out, the least recently used command is evicted. Being read by a getter counts as use, being updated doesn't,
+ * so commands nobody reads (e.g. audio levels) are the first to go.
+ */
+class ATEMcommandCache {
+  private:
+	struct Entry {
+		uint32_t _cmd;				// ATEM_fourCC
+		uint32_t _index;
+		uint16_t _offset;			// Of the payload in the arena
+		uint16_t _length;
+		uint32_t _lastUsed;			// _clock when last read or first stored
+	};
+	struct IndexOverride {
+		uint32_t _cmd;
+		uint8_t _indexLength;
+	};
+
+	uint8_t *_arena;
+	uint16_t _arenaSize;
+	uint16_t _arenaTop;				// End of the last payload in the arena. Gaps before it are closed by _compact()
+	uint16_t _liveBytes;			// Bytes of the arena used by entries
+	Entry *_entries;				// Sorted by command and index
+	uint8_t _maxEntries;
+	uint8_t _entryCount;
+	uint32_t _clock;
+
+	IndexOverride _indexOverrides[ATEM_commandCacheIndexOverrides];
+	uint8_t _indexOverrideCount;
+
+	unsigned long _stores;
+	unsigned long _evictions;
+	unsigned long _dropped;
+
+	uint8_t _indexLength(uint32_t cmd);
+	bool _find(uint32_t cmd, uint32_t index, uint8_t *position);
+	void _remove(uint8_t position);
+	void _evict();
+	void _compact();
+	const Entry *_use(uint32_t cmd, uint32_t index);
+
+  public:
+	ATEMcommandCache(uint16_t arenaSize, uint8_t maxEntries);
+	~ATEMcommandCache();
+
+	void store(uint32_t cmd, const uint8_t *cmdData, uint16_t cmdDataLength);
+	void clear();
+	bool setIndexLength(uint32_t cmd, uint8_t indexLength);
+
+	bool has(uint32_t cmd, uint32_t index);
+	const uint8_t *get(uint32_t cmd, uint32_t index, uint16_t *length);
+	uint8_t getUInt8(uint32_t cmd, uint32_t index, uint16_t offset);
+	uint16_t getUInt16(uint32_t cmd, uint32_t index, uint16_t offset);
+	uint32_t getUInt32(uint32_t cmd, uint32_t index, uint16_t offset);
+
+	// Decoders of common state, read from the cached payloads like the getters above. They return 0 when the command isn't cached
+	// (not sent yet, or evicted), which the has...() ones tell apart from a real 0
+	bool hasVideoMode();
+	uint8_t getVideoMode();
+	bool hasTopology();
+	uint8_t getTopologyMEs();
+	uint8_t getTopologySources();
+	uint8_t getTopologyAuxChannels();
+	uint8_t getTopologyDownstreamKeyers();
+	bool hasAuxSource(uint8_t auxChannel);
+	uint16_t getAuxSource(uint8_t auxChannel);
+	bool hasRecordingStatus();
+	uint16_t getRecordingStatusFlags();
+	bool isRecording();
+
+	uint8_t getEntryCount();
+	uint16_t getUsedBytes();
+	unsigned long getStoreCount();
+	unsigned long getEvictionCount();
+	unsigned long getDroppedCount();
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the modified version of Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client library for Arduino.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ATEMgroup.h"
+
+ATEMgroupTransport::ATEMgroupTransport() {
+	_group = NULL;
+	_index = 0;
+	_pendingSize = 0;
+}
+
+/**
+ * Opens the shared socket, see ATEMgroup::_startTransport()
+ */
+uint8_t ATEMgroupTransport::begin(uint16_t port) {
+	return _group->_startTransport(_index, port);
+}
+
+/**
+ * Nothing, as the other switchers may still be using the socket
+ */
+void ATEMgroupTransport::stop() {
+}
+
+int ATEMgroupTransport::parsePacket() {
+	return _pendingSize;
+}
+
+int ATEMgroupTransport::available() {
+	return _pendingSize > 0 ? _group->_transport->available() : 0;
+}
+
+int ATEMgroupTransport::read(uint8_t *buffer, size_t length) {
+	return _pendingSize > 0 ? _group->_transport->read(buffer, length) : -1;
+}
+
+IPAddress ATEMgroupTransport::remoteIP() {
+	return _group->_transport->remoteIP();
+}
+
+uint16_t ATEMgroupTransport::remotePort() {
+	return _group->_transport->remotePort();
+}
+
+/**
+ * Nothing, the group flushes the socket after handing over a datagram
+ */
+void ATEMgroupTransport::flush() {
+}
+
+int ATEMgroupTransport::beginPacket(IPAddress ip, uint16_t port) {
+	return _group->_transport->beginPacket(ip, port);
+}
+
+size_t ATEMgroupTransport::write(const uint8_t *buffer, size_t length) {
+	return _group->_transport->write(buffer, length);
+}
+
+int ATEMgroupTransport::endPacket() {
+	return _group->_transport->endPacket();
+}
+
+/**
+ * Constructor
+ */
+ATEMgroup::ATEMgroup() {
+	_transport = &_defaultTransport;
+	_transportStarted = false;
+	_clientCount = 0;
+	_strayDatagrams = 0;
+	for (uint8_t i = 0; i < ATEM_maxGroupSwitchers; i++) {
+		_clientTransports[i]._group = this;
+		_clientTransports[i]._index = i;
+	}
+}
+
+/**
+ * Use transport as the shared socket instead of the UDP of the board. Call it before the clients connect. NULL goes back to the default.
+ */
+void ATEMgroup::setTransport(UdpTransport *transport) {
+	_transport = transport != NULL ? transport : &_defaultTransport;
+}
+
+/**
+ * Adds client to the group, making it use the shared socket. Call it before client.begin().
+ * The switchers must have different IP addresses, as that's how datagrams are told apart. Returns false if the group is full.
+ */
+bool ATEMgroup::add(ATEMbase &client) {
+	if (_clientCount >= ATEM_maxGroupSwitchers) return false;
+
+	client.setTransport(&_clientTransports[_clientCount]);
+	_clients[_clientCount] = &client;
+	_clientCount++;
+	return true;
+}
+
+/**
+ * Like ATEMbase::runLoopBounded() for all switchers of the group. Datagrams are read from the shared socket until it's empty or the budget
+ * (maxPackets datagrams, maxMicros microseconds, 0 meaning no limit) runs out, each handed to the client of the switcher that sent it.
+ * After that every client acknowledges, retransmits and checks its connection.
+ */
+ATEMrunLoopResult ATEMgroup::runLoop(uint16_t maxPackets, unsigned long maxMicros) {
+	ATEMrunLoopResult result = {0, false};
+	unsigned long enterTime = micros();
+
+	while (_transportStarted) {
+		if ((maxPackets > 0 && result.packetsProcessed >= maxPackets) || (maxMicros > 0 && (unsigned long)(micros() - enterTime) >= maxMicros))	{
+			result.morePending = true;
+			break;
+		}
+
+		int packetSize = _transport->parsePacket();
+		if (!_transport->available()) break;
+
+		IPAddress remoteIP = _transport->remoteIP();
+		uint8_t i = 0;
+		while (i < _clientCount && !(_clients[i]->_switcherIP == remoteIP)) i++;
+		if (i < _clientCount) {
+			_clientTransports[i]._pendingSize = packetSize;
+			_clients[i]->_receiveDatagram();
+			_clientTransports[i]._pendingSize = 0;
+		} else {
+			_strayDatagrams++;
+		}
+		_transport->flush();
+		result.packetsProcessed++;
+	}
+
+	for (uint8_t i = 0; i < _clientCount; i++) {
+		_clients[i]->runLoopBounded(0, 0);	// Connects the first time. There's nothing for it to read, everything was handed over above
+	}
+	return result;
+}
+
+uint8_t ATEMgroup::getCount() {
+	return _clientCount;
+}
+
+ATEMbase *ATEMgroup::get(uint8_t index) {
+	return index < _clientCount ? _clients[index] : NULL;
+}
+
+/**
+ * Number of datagrams received from none of the switchers of the group, and dropped
+ */
+unsigned long ATEMgroup::getStrayDatagramCount() {
+	return _strayDatagrams;
+}
+
+/**
+ * Opens the shared socket on port for the client at index. If it's already open, it's only moved to the new port if none of the other
+ * clients are talking to their switcher, so with one switcher a reconnect gets a new port like a client on its own does.
+ * Otherwise a reconnecting client stays on the port of its last session, and says hello with a random temporary session ID
+ * instead of the usual one, so the switcher doesn't take it for the old session.
+ */
+uint8_t ATEMgroup::_startTransport(uint8_t index, uint16_t port) {
+	bool othersIdle = true;
+	for (uint8_t i = 0; i < _clientCount; i++) {
+		uint8_t phase = _clients[i]->getConnectionPhase();
+		if (i != index && phase != ATEM_phaseIdle && phase != ATEM_phaseReconnectWait) othersIdle = false;
+	}
+
+	if (!_transportStarted || othersIdle) {
+		if (_transportStarted) {
+			_transport->stop();
+		}
+		_transportStarted = _transport->begin(port);
+	} else if (_clients[index]->_udpStarted) {
+		_clients[index]->_sessionID = random(1, 0x8000);
+	}
+	return _transportStarted;
+}
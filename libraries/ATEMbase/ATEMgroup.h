@@ -0,0 +1,98 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the modified version of Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client library for Arduino.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ATEMgroup_h
+#define ATEMgroup_h
+
+#include "Arduino.h"
+
+#include <UdpTransport.h>
+#include "ATEMbase.h"
+
+#ifndef ATEM_maxGroupSwitchers
+#define ATEM_maxGroupSwitchers 4		// Number of switchers an ATEMgroup can follow
+#endif
+
+class ATEMgroup;
+
+/**
+ * What a client in an ATEMgroup sees as its transport. Sending goes straight to the shared socket.
+ * Receiving only sees the datagram the group hands it, so the client never polls the socket itself.
+ */
+class ATEMgroupTransport : public UdpTransport {
+  private:
+	ATEMgroup *_group;
+	uint8_t _index;
+	int _pendingSize;				// Size of the datagram handed to the client, 0 if none
+
+	friend class ATEMgroup;
+
+  public:
+	ATEMgroupTransport();
+
+	uint8_t begin(uint16_t port);
+	void stop();
+
+	int parsePacket();
+	int available();
+	int read(uint8_t *buffer, size_t length);
+	IPAddress remoteIP();
+	uint16_t remotePort();
+	void flush();
+
+	int beginPacket(IPAddress ip, uint16_t port);
+	size_t write(const uint8_t *buffer, size_t length);
+	int endPacket();
+};
+
+/**
+ * Follows several switchers at once, each with its own client (e.g. ATEMmin), through one UDP socket.
+ * runLoop() reads the socket once for all of them and hands each datagram to the client of the switcher it came from,
+ * so the cost of polling for datagrams doesn't grow with the number of switchers.
+ */
+class ATEMgroup {
+  private:
+	DefaultUdpTransport _defaultTransport;
+	UdpTransport *_transport;			// The shared socket
+	bool _transportStarted;
+
+	ATEMbase *_clients[ATEM_maxGroupSwitchers];
+	ATEMgroupTransport _clientTransports[ATEM_maxGroupSwitchers];
+	uint8_t _clientCount;
+
+	unsigned long _strayDatagrams;		// Datagrams from none of the switchers
+
+	uint8_t _startTransport(uint8_t index, uint16_t port);
+
+	friend class ATEMgroupTransport;
+
+  public:
+	ATEMgroup();
+
+	void setTransport(UdpTransport *transport);
+	bool add(ATEMbase &client);
+	ATEMrunLoopResult runLoop(uint16_t maxPackets, unsigned long maxMicros);
+
+	uint8_t getCount();
+	ATEMbase *get(uint8_t index);
+	unsigned long getStrayDatagramCount();
+};
+
+#endif
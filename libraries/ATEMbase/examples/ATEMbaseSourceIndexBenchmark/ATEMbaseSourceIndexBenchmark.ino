@@ -0,0 +1,181 @@
+/*****************
+ * ATEMbase source index benchmark
+ * Times the translation between video sources and indexes (getVideoSrcIndex() and getVideoIndexSrc()) against the
+ * switch statements they used to be, which only knew 20 inputs, 2 M/Es and 6 aux. No switcher or network connection is needed.
+ */
+
+#include <SkaarhojPgmspace.h>
+#include <ATEMbase.h>
+
+// Number of times all sources are looked up. Raise it for more stable numbers.
+#define BENCHMARK_ITERATIONS 2000
+
+// The switch statements as they were, for comparison. Not inlined, like the library functions they are compared with
+__attribute__((noinline)) uint8_t switchVideoSrcIndex(uint16_t videoSrc) {
+  switch (videoSrc) {
+    case 1: return 1;
+    case 2: return 2;
+    case 3: return 3;
+    case 4: return 4;
+    case 5: return 5;
+    case 6: return 6;
+    case 7: return 7;
+    case 8: return 8;
+    case 9: return 9;
+    case 10: return 10;
+    case 11: return 11;
+    case 12: return 12;
+    case 13: return 13;
+    case 14: return 14;
+    case 15: return 15;
+    case 16: return 16;
+    case 17: return 17;
+    case 18: return 18;
+    case 19: return 19;
+    case 20: return 20;
+    case 1000: return 21;
+    case 2001: return 22;
+    case 2002: return 23;
+    case 3010: return 24;
+    case 3011: return 25;
+    case 3020: return 26;
+    case 3021: return 27;
+    case 4010: return 28;
+    case 4020: return 29;
+    case 4030: return 30;
+    case 4040: return 31;
+    case 5010: return 32;
+    case 5020: return 33;
+    case 6000: return 34;
+    case 7001: return 35;
+    case 7002: return 36;
+    case 8001: return 37;
+    case 8002: return 38;
+    case 8003: return 39;
+    case 8004: return 40;
+    case 8005: return 41;
+    case 8006: return 42;
+    case 10010: return 43;
+    case 10011: return 44;
+    case 10020: return 45;
+    case 10021: return 46;
+    default: return 0;
+  }
+}
+
+__attribute__((noinline)) uint16_t switchVideoIndexSrc(uint8_t index) {
+  switch (index) {
+    case 1: return 1;
+    case 2: return 2;
+    case 3: return 3;
+    case 4: return 4;
+    case 5: return 5;
+    case 6: return 6;
+    case 7: return 7;
+    case 8: return 8;
+    case 9: return 9;
+    case 10: return 10;
+    case 11: return 11;
+    case 12: return 12;
+    case 13: return 13;
+    case 14: return 14;
+    case 15: return 15;
+    case 16: return 16;
+    case 17: return 17;
+    case 18: return 18;
+    case 19: return 19;
+    case 20: return 20;
+    case 21: return 1000;
+    case 22: return 2001;
+    case 23: return 2002;
+    case 24: return 3010;
+    case 25: return 3011;
+    case 26: return 3020;
+    case 27: return 3021;
+    case 28: return 4010;
+    case 29: return 4020;
+    case 30: return 4030;
+    case 31: return 4040;
+    case 32: return 5010;
+    case 33: return 5020;
+    case 34: return 6000;
+    case 35: return 7001;
+    case 36: return 7002;
+    case 37: return 8001;
+    case 38: return 8002;
+    case 39: return 8003;
+    case 40: return 8004;
+    case 41: return 8005;
+    case 42: return 8006;
+    case 43: return 10010;
+    case 44: return 10011;
+    case 45: return 10020;
+    case 46: return 10021;
+    default: return 0;
+  }
+}
+
+ATEMbase AtemSwitcher;
+volatile uint16_t sink;  // Keeps the compiler from dropping the lookups
+
+void printNsPerLookup(unsigned long micros, unsigned long lookups) {
+  Serial.print((float)micros * 1000.0 / lookups);
+  Serial.println(F(" ns/lookup"));
+}
+
+/**
+ * Times looking up sources (all in the table, or just the ones the switch knows) to index and back, with the table and with the switch
+ */
+void benchmark(bool allSources) {
+  uint16_t sourceList[255];
+  uint8_t sources = 0;
+  for (uint8_t i = 0; i < AtemSwitcher.maxAtemSeriesVideoInputs(); i++) {
+    uint16_t source = AtemSwitcher.getVideoIndexSrc(i);
+    if (allSources || i == 0 || switchVideoSrcIndex(source) != 0) sourceList[sources++] = source;
+  }
+  unsigned long lookups = (unsigned long)sources * BENCHMARK_ITERATIONS * 2;
+
+  unsigned long start = micros();
+  for (uint16_t n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    for (uint8_t i = 0; i < sources; i++) sink = AtemSwitcher.getVideoIndexSrc(AtemSwitcher.getVideoSrcIndex(sourceList[i]));
+  }
+  unsigned long elapsed = micros() - start;
+  Serial.print(F("  Table: "));
+  printNsPerLookup(elapsed, lookups);
+
+  start = micros();
+  for (uint16_t n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    for (uint8_t i = 0; i < sources; i++) sink = switchVideoIndexSrc(switchVideoSrcIndex(sourceList[i]));
+  }
+  elapsed = micros() - start;
+  Serial.print(F("  Switch: "));
+  printNsPerLookup(elapsed, lookups);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("\n- - - - - - - -\nATEMbase source index benchmark"));
+
+  uint8_t sources = AtemSwitcher.maxAtemSeriesVideoInputs();
+  Serial.print(F("Video sources in table: "));
+  Serial.println(sources);
+
+  // Check the table against the switch for the sources the switch knows
+  uint8_t mismatches = 0;
+  for (uint8_t i = 1; i < sources; i++) {
+    uint16_t source = AtemSwitcher.getVideoIndexSrc(i);
+    if (AtemSwitcher.getVideoSrcIndex(source) != i) mismatches++;
+    if (switchVideoSrcIndex(source) != 0 && switchVideoIndexSrc(switchVideoSrcIndex(source)) != source) mismatches++;
+  }
+  Serial.print(F("Mismatches: "));
+  Serial.println(mismatches);
+
+  // Sources the switch knows, then all sources of the table
+  Serial.println(F("Switch sources:"));
+  benchmark(false);
+  Serial.println(F("All sources:"));
+  benchmark(true);
+}
+
+void loop() {
+}
@@ -33,7 +33,72 @@ you can keep a clear conscience: http://skaarhoj.com/about/licenses/
 /**
  * Constructor (using arguments is deprecated! Use begin() instead)
  */
-ATEMmin::ATEMmin(){}
+ATEMmin::ATEMmin(){
+	_stateArena = NULL;
+	atemMEs = NULL;
+	atemAuxSourceInput = NULL;
+	atemDownstreamKeyers = NULL;
+	atemTallyByIndexTallyFlags = NULL;
+	_topologyMEs = 0;
+	_topologyAuxChannels = 0;
+	_topologyDownstreamKeyers = 0;
+	_topologyTallySources = 0;
+	atemTallyByIndexSources = 0;
+	streamingStatusFlags = 0;
+	_tallyStateSequence = 0;
+	_hasTallyState = false;
+	_tallyDeltas = 0;
+	_tallyServerFeatures = ATEM_tallyServerFeatureTallyDelta;
+}
+
+ATEMmin::~ATEMmin(){
+	delete[] _stateArena;
+}
+
+/**
+ * Sizes the switcher state for a topology, capped to ATEM_maxMEs etc. All of it is carved from one allocation, in the order
+ * M/Es, aux, downstream keyers, tally flags, so the 2 byte fields come first and stay aligned.
+ * Called when _top or _TlC arrives, which is once per connection, and only allocates if the topology changed. State kept for
+ * M/Es etc. that are still there is carried over, so a reconnect doesn't lose it.
+ */
+void ATEMmin::_allocateState(uint8_t mEs, uint8_t auxChannels, uint8_t downstreamKeyers, uint16_t tallySources) {
+	mEs = min(mEs, (uint8_t)ATEM_maxMEs);
+	auxChannels = min(auxChannels, (uint8_t)ATEM_maxAuxChannels);
+	downstreamKeyers = min(downstreamKeyers, (uint8_t)ATEM_maxDownstreamKeyers);
+	tallySources = min(tallySources, (uint16_t)ATEM_maxTallySources);
+	if (_stateArena != NULL && mEs == _topologyMEs && auxChannels == _topologyAuxChannels && downstreamKeyers == _topologyDownstreamKeyers && tallySources == _topologyTallySources) return;
+
+	size_t auxOffset = mEs * sizeof(MEState);
+	size_t downstreamKeyerOffset = auxOffset + auxChannels * sizeof(uint16_t);
+	size_t tallyOffset = downstreamKeyerOffset + downstreamKeyers * sizeof(DownstreamKeyerState);
+	size_t size = tallyOffset + tallySources;
+
+	uint8_t *arena = new uint8_t[size > 0 ? size : 1];
+	memset(arena, 0, size);
+	MEState *mEStates = (MEState *)arena;
+	uint16_t *auxSourceInput = (uint16_t *)(arena + auxOffset);
+	DownstreamKeyerState *downstreamKeyerStates = (DownstreamKeyerState *)(arena + downstreamKeyerOffset);
+	uint8_t *tallyFlags = arena + tallyOffset;
+
+	if (_stateArena != NULL) {
+		memcpy(mEStates, atemMEs, min(mEs, _topologyMEs) * sizeof(MEState));
+		memcpy(auxSourceInput, atemAuxSourceInput, min(auxChannels, _topologyAuxChannels) * sizeof(uint16_t));
+		memcpy(downstreamKeyerStates, atemDownstreamKeyers, min(downstreamKeyers, _topologyDownstreamKeyers) * sizeof(DownstreamKeyerState));
+		memcpy(tallyFlags, atemTallyByIndexTallyFlags, min(tallySources, _topologyTallySources));
+		delete[] _stateArena;
+	}
+
+	_stateArena = arena;
+	atemMEs = mEStates;
+	atemAuxSourceInput = auxSourceInput;
+	atemDownstreamKeyers = downstreamKeyerStates;
+	atemTallyByIndexTallyFlags = tallyFlags;
+	_topologyMEs = mEs;
+	_topologyAuxChannels = auxChannels;
+	_topologyDownstreamKeyers = downstreamKeyers;
+	_topologyTallySources = tallySources;
+	atemTallyByIndexSources = min(atemTallyByIndexSources, tallySources);
+}
 
 
 
@@ -51,33 +116,45 @@ ATEMmin::ATEMmin(){}
 		// **
 		// *********************************
 
-		void ATEMmin::_parseGetCommands(const char *cmdStr)	{
+		void ATEMmin::_parseGetCommands(uint32_t cmd, const uint8_t *cmdData, uint16_t cmdDataLength)	{
 			uint8_t mE,keyer,aUXChannel;
 			uint16_t sources;
 			long temp;
-			uint8_t readBytesForTlSr;
 
-			if (!strcmp_P(cmdStr, PSTR("AMLv")))	{
-				_readToPacketBuffer(36);
-			} else if (!strcmp_P(cmdStr, PSTR("TlSr")))	{
-				readBytesForTlSr = ((ATEM_packetBufferLength-2)/3)*3+2;
-				_readToPacketBuffer(readBytesForTlSr);
-			} else {
-				_readToPacketBuffer();	// Default
-			}
+			// Dispatch on the integer command name. The compiler turns this into a search over the case values,
+			// so the many commands we don't handle are rejected with a few integer compares.
+			switch (cmd)	{
+			case ATEM_fourCC('_','t','o','p'):	{	// Topology: M/Es in byte 0, aux in byte 3, downstream keyers in byte 4
+				if (cmdDataLength>=5)	{
+					_allocateState(cmdData[0], cmdData[3], cmdData[4], _topologyTallySources);
+					#if ATEM_debug
+					if (_serialOutput>0)	{
+						Serial.print(F("Topology: M/Es=")); Serial.print(_topologyMEs);
+						Serial.print(F(", aux=")); Serial.print(_topologyAuxChannels);
+						Serial.print(F(", DSKs=")); Serial.println(_topologyDownstreamKeyers);
+					}
+					#endif
+				}
+			} break;
 
+			case ATEM_fourCC('_','T','l','C'):	{	// Tally channel config: tally sources in byte 4
+				if (cmdDataLength>=5)	{
+					_allocateState(_topologyMEs, _topologyAuxChannels, _topologyDownstreamKeyers, cmdData[4]);
+				}
+			} break;
 
-			if (!strcmp_P(cmdStr, PSTR("_pin")))	{
-				if (_packetBuffer[5]=='T')	{
+			case ATEM_fourCC('_','p','i','n'):	{
+				if (cmdDataLength<30) break;	// Product name from byte 4
+				if (cmdData[5]=='T')	{
 						_ATEMmodel = 0;
 				} else
-				if (_packetBuffer[5]=='1')	{
-						_ATEMmodel = _packetBuffer[29]=='4' ? 4 : 1;
+				if (cmdData[5]=='1')	{
+						_ATEMmodel = cmdData[29]=='4' ? 4 : 1;
 				} else
-				if (_packetBuffer[5]=='2')	{
-					_ATEMmodel = _packetBuffer[29]=='4' ? 5 : 2;
+				if (cmdData[5]=='2')	{
+					_ATEMmodel = cmdData[29]=='4' ? 5 : 2;
 				} else
-				if (_packetBuffer[5]=='P')	{
+				if (cmdData[5]=='P')	{
 						_ATEMmodel = 3;
 				}
 
@@ -107,201 +184,202 @@ ATEMmin::ATEMmin(){}
 					}
 				}
 				#endif
-			}
-
-			
-
-
+			} break;
 
-			
-			if(!strcmp_P(cmdStr, PSTR("PrgI"))) {
-				
-				mE = _packetBuffer[0];
-				if (mE<=1) {
+			case ATEM_fourCC('P','r','g','I'):	{
+				if (cmdDataLength<4) break;
+				mE = cmdData[0];
+				if (mE<_topologyMEs) {
 					#if ATEM_debug
-					temp = atemProgramInputVideoSource[mE];
+					temp = atemMEs[mE].programInputVideoSource;
 					#endif
-					atemProgramInputVideoSource[mE] = word(_packetBuffer[2], _packetBuffer[3]);
+					atemMEs[mE].programInputVideoSource = word(cmdData[2], cmdData[3]);
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemProgramInputVideoSource[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].programInputVideoSource!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemProgramInputVideoSource[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemProgramInputVideoSource[mE]);
+						Serial.println(atemMEs[mE].programInputVideoSource);
 					}
 					#endif
 					
 				}
-			} else 
-			if(!strcmp_P(cmdStr, PSTR("PrvI"))) {
-				
-				mE = _packetBuffer[0];
-				if (mE<=1) {
+			} break;
+
+			case ATEM_fourCC('P','r','v','I'):	{
+				if (cmdDataLength<4) break;
+				mE = cmdData[0];
+				if (mE<_topologyMEs) {
 					#if ATEM_debug
-					temp = atemPreviewInputVideoSource[mE];
+					temp = atemMEs[mE].previewInputVideoSource;
 					#endif
-					atemPreviewInputVideoSource[mE] = word(_packetBuffer[2], _packetBuffer[3]);
+					atemMEs[mE].previewInputVideoSource = word(cmdData[2], cmdData[3]);
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemPreviewInputVideoSource[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].previewInputVideoSource!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemPreviewInputVideoSource[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemPreviewInputVideoSource[mE]);
+						Serial.println(atemMEs[mE].previewInputVideoSource);
 					}
 					#endif
 					
 				}
-			} else 
-			if(!strcmp_P(cmdStr, PSTR("TrPs"))) {
-				
-				mE = _packetBuffer[0];
-				if (mE<=1) {
+			} break;
+
+			case ATEM_fourCC('T','r','P','s'):	{
+				if (cmdDataLength<6) break;
+				mE = cmdData[0];
+				if (mE<_topologyMEs) {
 					#if ATEM_debug
-					temp = atemTransitionInTransition[mE];
+					temp = atemMEs[mE].transitionInTransition;
 					#endif
-					atemTransitionInTransition[mE] = _packetBuffer[1];
+					atemMEs[mE].transitionInTransition = cmdData[1];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemTransitionInTransition[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].transitionInTransition!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemTransitionInTransition[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemTransitionInTransition[mE]);
+						Serial.println(atemMEs[mE].transitionInTransition);
 					}
 					#endif
 					
 					#if ATEM_debug
-					temp = atemTransitionFramesRemaining[mE];
+					temp = atemMEs[mE].transitionFramesRemaining;
 					#endif
-					atemTransitionFramesRemaining[mE] = _packetBuffer[2];
+					atemMEs[mE].transitionFramesRemaining = cmdData[2];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemTransitionFramesRemaining[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].transitionFramesRemaining!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemTransitionFramesRemaining[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemTransitionFramesRemaining[mE]);
+						Serial.println(atemMEs[mE].transitionFramesRemaining);
 					}
 					#endif
 					
 					#if ATEM_debug
-					temp = atemTransitionPosition[mE];
+					temp = atemMEs[mE].transitionPosition;
 					#endif
-					atemTransitionPosition[mE] = word(_packetBuffer[4], _packetBuffer[5]);
+					atemMEs[mE].transitionPosition = word(cmdData[4], cmdData[5]);
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemTransitionPosition[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].transitionPosition!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemTransitionPosition[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemTransitionPosition[mE]);
+						Serial.println(atemMEs[mE].transitionPosition);
 					}
 					#endif
 					
 				}
-			} else 
-			if(!strcmp_P(cmdStr, PSTR("KeOn"))) {
-				
-				mE = _packetBuffer[0];
-				keyer = _packetBuffer[1];
-				if (mE<=1 && keyer<=3) {
+			} break;
+
+			case ATEM_fourCC('K','e','O','n'):	{
+				if (cmdDataLength<3) break;
+				mE = cmdData[0];
+				keyer = cmdData[1];
+				if (mE<_topologyMEs && keyer<ATEM_maxKeyers) {
 					#if ATEM_debug
-					temp = atemKeyerOnAirEnabled[mE][keyer];
+					temp = atemMEs[mE].keyerOnAirEnabled[keyer];
 					#endif
-					atemKeyerOnAirEnabled[mE][keyer] = _packetBuffer[2];
+					atemMEs[mE].keyerOnAirEnabled[keyer] = cmdData[2];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemKeyerOnAirEnabled[mE][keyer]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].keyerOnAirEnabled[keyer]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemKeyerOnAirEnabled[mE=")); Serial.print(mE); Serial.print(F("][keyer=")); Serial.print(keyer); Serial.print(F("] = "));
-						Serial.println(atemKeyerOnAirEnabled[mE][keyer]);
+						Serial.println(atemMEs[mE].keyerOnAirEnabled[keyer]);
 					}
 					#endif
 					
 				}
-			} else 
-			if(!strcmp_P(cmdStr, PSTR("DskS"))) {
-				
-				keyer = _packetBuffer[0];
-				if (keyer<=1) {
+			} break;
+
+			case ATEM_fourCC('D','s','k','S'):	{
+				if (cmdDataLength<5) break;
+				keyer = cmdData[0];
+				if (keyer<_topologyDownstreamKeyers) {
 					#if ATEM_debug
-					temp = atemDownstreamKeyerOnAir[keyer];
+					temp = atemDownstreamKeyers[keyer].onAir;
 					#endif
-					atemDownstreamKeyerOnAir[keyer] = _packetBuffer[1];
+					atemDownstreamKeyers[keyer].onAir = cmdData[1];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemDownstreamKeyerOnAir[keyer]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemDownstreamKeyers[keyer].onAir!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemDownstreamKeyerOnAir[keyer=")); Serial.print(keyer); Serial.print(F("] = "));
-						Serial.println(atemDownstreamKeyerOnAir[keyer]);
+						Serial.println(atemDownstreamKeyers[keyer].onAir);
 					}
 					#endif
 					
 					#if ATEM_debug
-					temp = atemDownstreamKeyerInTransition[keyer];
+					temp = atemDownstreamKeyers[keyer].inTransition;
 					#endif
-					atemDownstreamKeyerInTransition[keyer] = _packetBuffer[2];
+					atemDownstreamKeyers[keyer].inTransition = cmdData[2];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemDownstreamKeyerInTransition[keyer]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemDownstreamKeyers[keyer].inTransition!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemDownstreamKeyerInTransition[keyer=")); Serial.print(keyer); Serial.print(F("] = "));
-						Serial.println(atemDownstreamKeyerInTransition[keyer]);
+						Serial.println(atemDownstreamKeyers[keyer].inTransition);
 					}
 					#endif
 					
 					#if ATEM_debug
-					temp = atemDownstreamKeyerIsAutoTransitioning[keyer];
+					temp = atemDownstreamKeyers[keyer].isAutoTransitioning;
 					#endif
-					atemDownstreamKeyerIsAutoTransitioning[keyer] = _packetBuffer[3];
+					atemDownstreamKeyers[keyer].isAutoTransitioning = cmdData[3];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemDownstreamKeyerIsAutoTransitioning[keyer]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemDownstreamKeyers[keyer].isAutoTransitioning!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemDownstreamKeyerIsAutoTransitioning[keyer=")); Serial.print(keyer); Serial.print(F("] = "));
-						Serial.println(atemDownstreamKeyerIsAutoTransitioning[keyer]);
+						Serial.println(atemDownstreamKeyers[keyer].isAutoTransitioning);
 					}
 					#endif
 					
 					#if ATEM_debug
-					temp = atemDownstreamKeyerFramesRemaining[keyer];
+					temp = atemDownstreamKeyers[keyer].framesRemaining;
 					#endif
-					atemDownstreamKeyerFramesRemaining[keyer] = _packetBuffer[4];
+					atemDownstreamKeyers[keyer].framesRemaining = cmdData[4];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemDownstreamKeyerFramesRemaining[keyer]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemDownstreamKeyers[keyer].framesRemaining!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemDownstreamKeyerFramesRemaining[keyer=")); Serial.print(keyer); Serial.print(F("] = "));
-						Serial.println(atemDownstreamKeyerFramesRemaining[keyer]);
+						Serial.println(atemDownstreamKeyers[keyer].framesRemaining);
 					}
 					#endif
 					
 				}
-			} else 
-			if(!strcmp_P(cmdStr, PSTR("FtbS"))) {
-				
-				mE = _packetBuffer[0];
-				if (mE<=1) {
+			} break;
+
+			case ATEM_fourCC('F','t','b','S'):	{
+				if (cmdDataLength<4) break;
+				mE = cmdData[0];
+				if (mE<_topologyMEs) {
 					#if ATEM_debug
-					temp = atemFadeToBlackStateFullyBlack[mE];
+					temp = atemMEs[mE].fadeToBlackStateFullyBlack;
 					#endif
-					atemFadeToBlackStateFullyBlack[mE] = _packetBuffer[1];
+					atemMEs[mE].fadeToBlackStateFullyBlack = cmdData[1];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemFadeToBlackStateFullyBlack[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].fadeToBlackStateFullyBlack!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemFadeToBlackStateFullyBlack[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemFadeToBlackStateFullyBlack[mE]);
+						Serial.println(atemMEs[mE].fadeToBlackStateFullyBlack);
 					}
 					#endif
 					
 					#if ATEM_debug
-					temp = atemFadeToBlackStateInTransition[mE];
+					temp = atemMEs[mE].fadeToBlackStateInTransition;
 					#endif
-					atemFadeToBlackStateInTransition[mE] = _packetBuffer[2];
+					atemMEs[mE].fadeToBlackStateInTransition = cmdData[2];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemFadeToBlackStateInTransition[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].fadeToBlackStateInTransition!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemFadeToBlackStateInTransition[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemFadeToBlackStateInTransition[mE]);
+						Serial.println(atemMEs[mE].fadeToBlackStateInTransition);
 					}
 					#endif
 					
 					#if ATEM_debug
-					temp = atemFadeToBlackStateFramesRemaining[mE];
+					temp = atemMEs[mE].fadeToBlackStateFramesRemaining;
 					#endif
-					atemFadeToBlackStateFramesRemaining[mE] = _packetBuffer[3];
+					atemMEs[mE].fadeToBlackStateFramesRemaining = cmdData[3];
 					#if ATEM_debug
-					if ((_serialOutput==0x80 && atemFadeToBlackStateFramesRemaining[mE]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
+					if ((_serialOutput==0x80 && atemMEs[mE].fadeToBlackStateFramesRemaining!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemFadeToBlackStateFramesRemaining[mE=")); Serial.print(mE); Serial.print(F("] = "));
-						Serial.println(atemFadeToBlackStateFramesRemaining[mE]);
+						Serial.println(atemMEs[mE].fadeToBlackStateFramesRemaining);
 					}
 					#endif
 					
 				}
-			} else 
-			if(!strcmp_P(cmdStr, PSTR("AuxS"))) {
-				
-				aUXChannel = _packetBuffer[0];
-				if (aUXChannel<=5) {
+			} break;
+
+			case ATEM_fourCC('A','u','x','S'):	{
+				if (cmdDataLength<4) break;
+				aUXChannel = cmdData[0];
+				if (aUXChannel<_topologyAuxChannels) {
 					#if ATEM_debug
 					temp = atemAuxSourceInput[aUXChannel];
 					#endif
-					atemAuxSourceInput[aUXChannel] = word(_packetBuffer[2], _packetBuffer[3]);
+					atemAuxSourceInput[aUXChannel] = word(cmdData[2], cmdData[3]);
 					#if ATEM_debug
 					if ((_serialOutput==0x80 && atemAuxSourceInput[aUXChannel]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemAuxSourceInput[aUXChannel=")); Serial.print(aUXChannel); Serial.print(F("] = "));
@@ -310,15 +388,22 @@ ATEMmin::ATEMmin(){}
 					#endif
 					
 				}
-			} else 
-			if(!strcmp_P(cmdStr, PSTR("TlIn"))) {
-				
-				sources = word(_packetBuffer[0],_packetBuffer[1]);
-				if (sources<=40) {
+			} break;
+
+			case ATEM_fourCC('T','l','I','n'):	{
+				if (cmdDataLength<2) break;
+				sources = word(cmdData[0],cmdData[1]);
+				if (sources>ATEM_maxTallySources)	{	// Only the first ones are kept
+					sources = ATEM_maxTallySources;
+				}
+				if (sources>_topologyTallySources)	{	// Only if _TlC was filtered out or never came
+					_allocateState(_topologyMEs, _topologyAuxChannels, _topologyDownstreamKeyers, sources);
+				}
+				if (sources<=_topologyTallySources && 2+sources<=cmdDataLength) {
 					#if ATEM_debug
 					temp = atemTallyByIndexSources;
 					#endif
-					atemTallyByIndexSources = word(_packetBuffer[0], _packetBuffer[1]);
+					atemTallyByIndexSources = sources;
 					#if ATEM_debug
 					if ((_serialOutput==0x80 && atemTallyByIndexSources!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 						Serial.print(F("atemTallyByIndexSources = "));
@@ -330,7 +415,7 @@ ATEMmin::ATEMmin(){}
 						#if ATEM_debug
 						temp = atemTallyByIndexTallyFlags[a];
 						#endif
-						atemTallyByIndexTallyFlags[a] = _packetBuffer[2+a];
+						atemTallyByIndexTallyFlags[a] = cmdData[2+a];
 						#if ATEM_debug
 						if ((_serialOutput==0x80 && atemTallyByIndexTallyFlags[a]!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 							Serial.print(F("atemTallyByIndexTallyFlags[a=")); Serial.print(a); Serial.print(F("] = "));
@@ -340,23 +425,63 @@ ATEMmin::ATEMmin(){}
 					}
 		
 				}
-			}
+				_hasTallyState = false;	// Until the stamp following it from a TallyServer
+			} break;
+
+			/**
+			 * Added by Aron N. Het Lam
+			 * Tally delta from a TallyServer: the (index, flag) pairs that changed, stamped with the sequence of the state they lead to
+			 * and the one they apply to. That's the last state we acknowledged, so they also apply to any state held after it, and one
+			 * already held is ignored. One flagged as the full state stamps the TlIn before it in the packet instead. A delta applying
+			 * to a state after the one held means one was missed, so it's dropped and the whole state asked for.
+			 */
+			case ATEM_fourCC('T','l','D','l'):	{
+				if (cmdDataLength < 6) break;
+				uint16_t sequence = word(cmdData[0], cmdData[1]);
+				uint16_t baseSequence = word(cmdData[2], cmdData[3]);
+				uint8_t pairs = cmdData[4];
+
+				if (cmdData[5] & ATEM_tallyDeltaFullState)	{
+					_tallyStateSequence = sequence;
+					_hasTallyState = true;
+					_tallyStateWanted = false;
+				} else if (_hasTallyState && (int16_t)(sequence - _tallyStateSequence) <= 0)	{
+					break;	// Held already
+				} else if (_hasTallyState && (int16_t)(_tallyStateSequence - baseSequence) >= 0 && 6+2*pairs <= cmdDataLength)	{
+					for(uint8_t a=0;a<pairs;a++)	{
+						uint8_t index = cmdData[6+2*a];
+						if (index<atemTallyByIndexSources)	{
+							atemTallyByIndexTallyFlags[index] = cmdData[6+2*a+1];
+						}
+					}
+					_tallyStateSequence = sequence;
+					_tallyDeltas++;
+				} else {
+					_hasTallyState = false;
+					if (!_tallyStateWanted)	{	// Asked for from runLoop(), not while parsing
+						_tallyStateWanted = true;
+						_tallyStateRequestedAt = 0;
+					}
+				}
+			} break;
+
 			/**
 			 * Added by Aron N. Het Lam
 			 * Functionality to parse and retrieve streaming status.
 			 */
-		else 
-			if(!strcmp_P(cmdStr, PSTR("StRS"))) {
+			case ATEM_fourCC('S','t','R','S'):	{
+				if (cmdDataLength<2) break;
 				#if ATEM_debug
 				temp = streamingStatusFlags;
 				#endif
-				streamingStatusFlags = word(_packetBuffer[0], _packetBuffer[1]);
+				streamingStatusFlags = word(cmdData[0], cmdData[1]);
 				#if ATEM_debug
 				if ((_serialOutput==0x80 && streamingStatusFlags!=temp) || (_serialOutput==0x81 && !hasInitialized()))	{
 					Serial.print(F("streamingStatusFlags = "));
 					Serial.println(streamingStatusFlags);
 				}
 				#endif
+			} break;
 			}
 		}
 
@@ -369,7 +494,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			uint16_t ATEMmin::getProgramInputVideoSource(uint8_t mE) {
-				return atemProgramInputVideoSource[mE];
+				return mE<_topologyMEs ? atemMEs[mE].programInputVideoSource : 0;
 			}
 			
 			/**
@@ -395,7 +520,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			uint16_t ATEMmin::getPreviewInputVideoSource(uint8_t mE) {
-				return atemPreviewInputVideoSource[mE];
+				return mE<_topologyMEs ? atemMEs[mE].previewInputVideoSource : 0;
 			}
 			
 			/**
@@ -449,7 +574,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			bool ATEMmin::getTransitionInTransition(uint8_t mE) {
-				return atemTransitionInTransition[mE];
+				return mE<_topologyMEs ? atemMEs[mE].transitionInTransition : 0;
 			}
 			
 			/**
@@ -457,7 +582,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			uint8_t ATEMmin::getTransitionFramesRemaining(uint8_t mE) {
-				return atemTransitionFramesRemaining[mE];
+				return mE<_topologyMEs ? atemMEs[mE].transitionFramesRemaining : 0;
 			}
 			
 			/**
@@ -465,7 +590,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			uint16_t ATEMmin::getTransitionPosition(uint8_t mE) {
-				return atemTransitionPosition[mE];
+				return mE<_topologyMEs ? atemMEs[mE].transitionPosition : 0;
 			}
 			
 			/**
@@ -492,7 +617,7 @@ ATEMmin::ATEMmin(){}
 			 * keyer 	0-3: Keyer 1-4
 			 */
 			bool ATEMmin::getKeyerOnAirEnabled(uint8_t mE, uint8_t keyer) {
-				return atemKeyerOnAirEnabled[mE][keyer];
+				return mE<_topologyMEs && keyer<ATEM_maxKeyers ? atemMEs[mE].keyerOnAirEnabled[keyer] : 0;
 			}
 			
 			/**
@@ -520,7 +645,7 @@ ATEMmin::ATEMmin(){}
 			 * keyer 	0: DSK1, 1: DSK2
 			 */
 			bool ATEMmin::getDownstreamKeyerOnAir(uint8_t keyer) {
-				return atemDownstreamKeyerOnAir[keyer];
+				return keyer<_topologyDownstreamKeyers ? atemDownstreamKeyers[keyer].onAir : 0;
 			}
 			
 			/**
@@ -528,7 +653,7 @@ ATEMmin::ATEMmin(){}
 			 * keyer 	0: DSK1, 1: DSK2
 			 */
 			bool ATEMmin::getDownstreamKeyerInTransition(uint8_t keyer) {
-				return atemDownstreamKeyerInTransition[keyer];
+				return keyer<_topologyDownstreamKeyers ? atemDownstreamKeyers[keyer].inTransition : 0;
 			}
 			
 			/**
@@ -536,7 +661,7 @@ ATEMmin::ATEMmin(){}
 			 * keyer 	0: DSK1, 1: DSK2
 			 */
 			bool ATEMmin::getDownstreamKeyerIsAutoTransitioning(uint8_t keyer) {
-				return atemDownstreamKeyerIsAutoTransitioning[keyer];
+				return keyer<_topologyDownstreamKeyers ? atemDownstreamKeyers[keyer].isAutoTransitioning : 0;
 			}
 			
 			/**
@@ -544,7 +669,7 @@ ATEMmin::ATEMmin(){}
 			 * keyer 	0: DSK1, 1: DSK2
 			 */
 			uint8_t ATEMmin::getDownstreamKeyerFramesRemaining(uint8_t keyer) {
-				return atemDownstreamKeyerFramesRemaining[keyer];
+				return keyer<_topologyDownstreamKeyers ? atemDownstreamKeyers[keyer].framesRemaining : 0;
 			}
 			
 			/**
@@ -569,7 +694,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			bool ATEMmin::getFadeToBlackStateFullyBlack(uint8_t mE) {
-				return atemFadeToBlackStateFullyBlack[mE];
+				return mE<_topologyMEs ? atemMEs[mE].fadeToBlackStateFullyBlack : 0;
 			}
 			
 			/**
@@ -577,7 +702,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			bool ATEMmin::getFadeToBlackStateInTransition(uint8_t mE) {
-				return atemFadeToBlackStateInTransition[mE];
+				return mE<_topologyMEs ? atemMEs[mE].fadeToBlackStateInTransition : 0;
 			}
 			
 			/**
@@ -585,7 +710,7 @@ ATEMmin::ATEMmin(){}
 			 * mE 	0: ME1, 1: ME2
 			 */
 			uint8_t ATEMmin::getFadeToBlackStateFramesRemaining(uint8_t mE) {
-				return atemFadeToBlackStateFramesRemaining[mE];
+				return mE<_topologyMEs ? atemMEs[mE].fadeToBlackStateFramesRemaining : 0;
 			}
 			
 
@@ -610,7 +735,7 @@ ATEMmin::ATEMmin(){}
 			 * aUXChannel 	0-5: Aux 1-6
 			 */
 			uint16_t ATEMmin::getAuxSourceInput(uint8_t aUXChannel) {
-				return atemAuxSourceInput[aUXChannel];
+				return aUXChannel<_topologyAuxChannels ? atemAuxSourceInput[aUXChannel] : 0;
 			}
 			
 			/**
@@ -643,12 +768,72 @@ ATEMmin::ATEMmin(){}
 			
 			/**
 			 * Get Tally By Index; Tally Flags
-			 * sources 	0-40: Number of
+			 * sources 	0-(getTallyByIndexSources()-1): Number of
 			 */
 			uint8_t ATEMmin::getTallyByIndexTallyFlags(uint16_t sources) {
-				return atemTallyByIndexTallyFlags[sources];
+				return sources<atemTallyByIndexSources ? atemTallyByIndexTallyFlags[sources] : 0;
 			}
 			
+			/**
+			 * Get the number of M/Es of the switcher, as far as state is kept for them (see ATEM_maxMEs). 0 until the topology is known
+			 */
+			uint8_t ATEMmin::getTopologyMEs() {
+				return _topologyMEs;
+			}
+
+			/**
+			 * Get the number of aux outputs state is kept for (see ATEM_maxAuxChannels)
+			 */
+			uint8_t ATEMmin::getTopologyAuxChannels() {
+				return _topologyAuxChannels;
+			}
+
+			/**
+			 * Get the number of downstream keyers state is kept for (see ATEM_maxDownstreamKeyers)
+			 */
+			uint8_t ATEMmin::getTopologyDownstreamKeyers() {
+				return _topologyDownstreamKeyers;
+			}
+
+			/**
+			 * Get the number of tally sources state is kept for (see ATEM_maxTallySources)
+			 */
+			uint16_t ATEMmin::getTopologyTallySources() {
+				return _topologyTallySources;
+			}
+
+			/**
+			 * Get the number of tally deltas applied (Added by Aron N. Het Lam)
+			 */
+			unsigned long ATEMmin::getTallyDeltaCount() {
+				return _tallyDeltas;
+			}
+
+			/**
+			 * Only get the tally flags of count indexes from a TallyServer, instead of all of them (Added by Aron N. Het Lam)
+			 * It then sends the tally flags up to the highest one, and nothing when none of them changed. Flags of other indexes
+			 * below it aren't kept up to date. A count of 0, or an index above 55, subscribes to all again.
+			 * Told to the TallyServer when connecting, and right away if connected. Switchers send all tally flags regardless.
+			 */
+			void ATEMmin::setTallySubscription(const uint8_t *indexes, uint8_t count) {
+				memset(_tallySubscription, 0, ATEM_tallySubscriptionLength);
+				for(uint8_t a=0;a<count;a++)	{
+					if (indexes[a] >= ATEM_tallySubscriptionLength*8)	{
+						memset(_tallySubscription, 0, ATEM_tallySubscriptionLength);
+						break;
+					}
+					_tallySubscription[indexes[a]/8] |= 1 << (indexes[a]%8);
+				}
+
+				if (_isTallyServer)	{
+	  	  			_prepareCommandPacket(PSTR("TlSb"),8);
+
+					memcpy(_packetBuffer+12+_cBBO+4+4, _tallySubscription, ATEM_tallySubscriptionLength);
+
+	 	   			_finishCommandPacket();
+				}
+			}
+
 			/**
 			 * Get raw streaming staus flags
 			 */
@@ -33,17 +33,35 @@ you can keep a clear conscience: http://skaarhoj.com/about/licenses/
 #include "Arduino.h"
 #include "ATEMbase.h"
 
-#if defined ESP8266 || defined ESP32
-#include <WiFiUdp.h>
-#else
-#include <EthernetUdp.h>
+
+// Most switcher state kept by ATEMmin. The state itself is sized from the topology the switcher reports when connecting (_top and _TlC),
+// these only cap it. They can be overridden per build without editing this file, e.g. with "-D ATEM_maxMEs=2" in build_flags of platformio.ini
+// State for M/Es, keyers etc. beyond the topology or these caps is ignored.
+#ifndef ATEM_maxMEs
+#define ATEM_maxMEs 4					// Number of M/Es
+#endif
+#ifndef ATEM_maxKeyers
+#define ATEM_maxKeyers 4				// Number of upstream keyers per M/E. Kept for every M/E, whatever the switcher has
+#endif
+#ifndef ATEM_maxDownstreamKeyers
+#define ATEM_maxDownstreamKeyers 4		// Number of downstream keyers
+#endif
+#ifndef ATEM_maxAuxChannels
+#define ATEM_maxAuxChannels 24			// Number of aux outputs
+#endif
+#ifndef ATEM_maxTallySources
+#define ATEM_maxTallySources 81			// Number of tally by index sources
 #endif
 
+static_assert(ATEM_maxMEs <= 255 && ATEM_maxDownstreamKeyers <= 255 && ATEM_maxAuxChannels <= 255, "M/Es, downstream keyers and aux are indexed by one byte");
+static_assert(ATEM_maxTallySources <= 255, "Tally sources are indexed by one byte, as in _TlC and TlDl");
+
 
 class ATEMmin : public ATEMbase
 {
   public:
 	ATEMmin();  
+	~ATEMmin();
 	  
 // *********************************
 // **
@@ -64,28 +82,50 @@ class ATEMmin : public ATEMbase
 
 
 private:
-	void _parseGetCommands(const char *cmdStr);
+	void _parseGetCommands(uint32_t cmd, const uint8_t *cmdData, uint16_t cmdDataLength);
 
 			// Private Variables in ATEM.h:
 	
-			uint16_t atemProgramInputVideoSource[2];
-			uint16_t atemPreviewInputVideoSource[2];
-			bool atemTransitionInTransition[2];
-			uint8_t atemTransitionFramesRemaining[2];
-			uint16_t atemTransitionPosition[2];
-			bool atemKeyerOnAirEnabled[2][4];
-			bool atemDownstreamKeyerOnAir[2];
-			bool atemDownstreamKeyerInTransition[2];
-			bool atemDownstreamKeyerIsAutoTransitioning[2];
-			uint8_t atemDownstreamKeyerFramesRemaining[2];
-			bool atemFadeToBlackStateFullyBlack[2];
-			bool atemFadeToBlackStateInTransition[2];
-			uint8_t atemFadeToBlackStateFramesRemaining[2];
-			uint16_t atemAuxSourceInput[6];
+			struct MEState {
+				uint16_t programInputVideoSource;
+				uint16_t previewInputVideoSource;
+				uint16_t transitionPosition;
+				bool transitionInTransition;
+				uint8_t transitionFramesRemaining;
+				bool fadeToBlackStateFullyBlack;
+				bool fadeToBlackStateInTransition;
+				uint8_t fadeToBlackStateFramesRemaining;
+				bool keyerOnAirEnabled[ATEM_maxKeyers];
+			};
+			struct DownstreamKeyerState {
+				bool onAir;
+				bool inTransition;
+				bool isAutoTransitioning;
+				uint8_t framesRemaining;
+			};
+
+			// All of it lives in _stateArena, sized by _allocateState() for the topology of the switcher
+			uint8_t *_stateArena;
+			MEState *atemMEs;
+			uint16_t *atemAuxSourceInput;
+			DownstreamKeyerState *atemDownstreamKeyers;
+			uint8_t *atemTallyByIndexTallyFlags;
+			uint8_t _topologyMEs;
+			uint8_t _topologyAuxChannels;
+			uint8_t _topologyDownstreamKeyers;
+			uint16_t _topologyTallySources;
+
+			void _allocateState(uint8_t mEs, uint8_t auxChannels, uint8_t downstreamKeyers, uint16_t tallySources);
+
 			uint16_t atemTallyByIndexSources;
-			uint8_t atemTallyByIndexTallyFlags[41];
 			uint16_t streamingStatusFlags; //Added by Aron N. Het Lam
 
+			// Tally deltas (TlDl) from a TallyServer. Added by Aron N. Het Lam
+			uint16_t _tallyStateSequence;		// Sequence of the tally state held, as stamped by the TallyServer
+			bool _hasTallyState;				// A stamped TlIn has arrived, so deltas following it can be applied
+			unsigned long _tallyDeltas;			// Number of deltas applied
+
+
 public:
 			// Public Methods in ATEM.h:
 	
@@ -115,6 +155,13 @@ public:
 			uint16_t getTallyByIndexSources();
 			uint8_t getTallyByIndexTallyFlags(uint16_t sources);
 
+			uint8_t getTopologyMEs();
+			uint8_t getTopologyAuxChannels();
+			uint8_t getTopologyDownstreamKeyers();
+			uint16_t getTopologyTallySources();
+			unsigned long getTallyDeltaCount();
+			void setTallySubscription(const uint8_t *indexes, uint8_t count);
+
 			//Added by Aron N. Het Lam
 			uint16_t getStreamingStatusFlags();
 			bool getStreamIdle();
@@ -0,0 +1,88 @@
+/*****************
+ * ATEMmin command cache
+ * Connects to a switcher over WiFi and keeps everything it sends in an ATEMcommandCache, then prints state ATEMmin doesn't parse
+ * every 5 seconds: the video mode, the topology, the sources of all aux outputs and if it's recording. Nothing is decoded until it's printed.
+ *
+ * The cache is sized for an ESP8266. Raise COMMAND_CACHE_SIZE and COMMAND_CACHE_ENTRIES on boards with more RAM for fewer evictions.
+ */
+
+#if defined ESP32
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include <SkaarhojPgmspace.h>
+#include <ATEMbase.h>
+#include <ATEMmin.h>
+
+#define COMMAND_CACHE_SIZE 4096      // Bytes for payloads
+#define COMMAND_CACHE_ENTRIES 128    // Commands kept
+
+const char *ssid = "Network name";           // <= SETUP!
+const char *password = "Password";           // <= SETUP!
+IPAddress switcherIp(192, 168, 10, 240);     // <= SETUP!  IP address of the ATEM Switcher
+
+ATEMmin AtemSwitcher;
+ATEMcommandCache commandCache(COMMAND_CACHE_SIZE, COMMAND_CACHE_ENTRIES);
+
+unsigned long lastReport = 0;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("\n- - - - - - - -\nSerial Started"));
+
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(100);
+  }
+  Serial.print(F("WiFi connected, IP "));
+  Serial.println(WiFi.localIP());
+
+  AtemSwitcher.setCommandCache(&commandCache);
+  AtemSwitcher.begin(switcherIp);
+  AtemSwitcher.serialOutput(1);
+}
+
+void loop() {
+  AtemSwitcher.runLoop();
+
+  if (AtemSwitcher.hasInitialized() && millis() - lastReport > 5000) {
+    Serial.println(F("------------------------"));
+    // Getters return 0 for what isn't cached (e.g. evicted when the cache is full), so check with has...() first
+    Serial.print(F("Video mode: "));
+    if (commandCache.hasVideoMode()) Serial.println(commandCache.getVideoMode());
+    else Serial.println(F("unknown"));
+
+    uint8_t auxs = 0;
+    if (commandCache.hasTopology()) {
+      auxs = commandCache.getTopologyAuxChannels();
+      Serial.print(F("M/Es: "));
+      Serial.print(commandCache.getTopologyMEs());
+      Serial.print(F(", aux: "));
+      Serial.println(auxs);
+    } else {
+      Serial.println(F("Topology unknown"));
+    }
+
+    for (uint8_t aux = 0; aux < auxs; aux++) {
+      Serial.print(F("  Aux "));
+      Serial.print(aux + 1);
+      Serial.print(F(": "));
+      if (commandCache.hasAuxSource(aux)) Serial.println(commandCache.getAuxSource(aux));
+      else Serial.println(F("unknown"));
+    }
+
+    Serial.print(F("Recording: "));
+    if (commandCache.hasRecordingStatus()) Serial.println(commandCache.isRecording() ? F("yes") : F("no"));
+    else Serial.println(F("unknown"));
+
+    Serial.print(F("Cached commands: "));
+    Serial.print(commandCache.getEntryCount());
+    Serial.print(F(", bytes: "));
+    Serial.print(commandCache.getUsedBytes());
+    Serial.print(F(", evicted: "));
+    Serial.println(commandCache.getEvictionCount());
+    lastReport = millis();
+  }
+}
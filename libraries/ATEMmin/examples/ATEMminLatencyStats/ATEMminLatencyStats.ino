@@ -0,0 +1,81 @@
+/*****************
+ * ATEMmin latency stats
+ * Connects to a switcher over WiFi and prints the latency histograms of ATEMbase every 10 seconds:
+ * Round trip time of command packets and its jitter, and time from reading a datagram until it's parsed.
+ * A cut is performed on M/E 1 once a second, to have something to measure the round trip on. Point it at a switcher nobody is using!
+ *
+ * Use it as a baseline when moving the access point, the tally or changing firmware.
+ */
+
+#if defined ESP32
+#include <WiFi.h>
+#else
+#include <ESP8266WiFi.h>
+#endif
+#include <SkaarhojPgmspace.h>
+#include <ATEMbase.h>
+#include <ATEMmin.h>
+
+const char *ssid = "Network name";           // <= SETUP!
+const char *password = "Password";           // <= SETUP!
+IPAddress switcherIp(192, 168, 10, 240);     // <= SETUP!  IP address of the ATEM Switcher
+
+ATEMmin AtemSwitcher;
+
+unsigned long lastCut = 0;
+unsigned long lastReport = 0;
+
+void printHistogram(const char *name, const ATEMhistogram &histogram) {
+  Serial.print(name);
+  Serial.print(F(": "));
+  Serial.print(histogram.count);
+  Serial.print(F(" samples, mean "));
+  Serial.print(histogram.count > 0 ? (unsigned long)(histogram.sum / histogram.count) : 0);
+  Serial.print(F(" us, max "));
+  Serial.print(histogram.max);
+  Serial.println(F(" us"));
+
+  for (uint8_t i = 0; i < ATEM_histogramBuckets; i++) {
+    if (histogram.buckets[i] == 0) continue;
+    Serial.print(F("  < "));
+    if (i == ATEM_histogramBuckets - 1) Serial.print(F("inf"));
+    else Serial.print(1UL << i);
+    Serial.print(F(" us: "));
+    Serial.println(histogram.buckets[i]);
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("\n- - - - - - - -\nSerial Started"));
+
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(100);
+  }
+  Serial.print(F("WiFi connected, IP "));
+  Serial.println(WiFi.localIP());
+
+  AtemSwitcher.begin(switcherIp);
+  AtemSwitcher.serialOutput(1);
+}
+
+void loop() {
+  AtemSwitcher.runLoop();
+
+  if (AtemSwitcher.hasInitialized() && millis() - lastCut > 1000) {
+    AtemSwitcher.performCutME(0);
+    lastCut = millis();
+  }
+
+  if (millis() - lastReport > 10000) {
+    const ATEMlatencyStats &stats = AtemSwitcher.getLatencyStats();
+    Serial.println(F("------------------------"));
+    printHistogram("Ack round trip", stats.ackRoundTrip);
+    printHistogram("Ack jitter", stats.ackJitter);
+    printHistogram("Processing", stats.processing);
+    AtemSwitcher.resetLatencyStats();
+    lastReport = millis();
+  }
+}
@@ -0,0 +1,103 @@
+/*****************
+ * ATEMmin parse benchmark
+ * Feeds a synthetic copy of a 2 M/E switchers initialization dump through the command parser of ATEMmin
+ * and prints how long it takes per command. No switcher or network connection is needed.
+ *
+ * The dump holds the commands (names, lengths and counts) observed during initialization, but all payloads are zero.
+ * Most of the commands are ones ATEMmin doesn't care about, which is what makes the dispatch matter.
+ */
+
+#include <SkaarhojPgmspace.h>
+#include <ATEMbase.h>
+#include <ATEMmin.h>
+
+// Number of times each packet is parsed. Raise it for more stable numbers.
+#define BENCHMARK_ITERATIONS 200
+
+struct DumpCommand {
+  char name[5];
+  uint16_t dataLength;
+  uint8_t count;
+};
+
+// Command name, payload length and number of occurrences in the dump
+const DumpCommand initDump[] = {
+  {"_ver", 4, 1}, {"_pin", 44, 1}, {"_top", 20, 1}, {"_MeC", 4, 2}, {"_mpl", 4, 1}, {"_MvC", 4, 1}, {"_SSC", 4, 1},
+  {"_TlC", 8, 1}, {"_AMC", 4, 1}, {"_VMC", 4, 1}, {"_MAC", 4, 1}, {"Powr", 4, 1}, {"VidM", 4, 1}, {"InPr", 36, 40},
+  {"MvPr", 4, 4}, {"MvIn", 4, 40}, {"SSrc", 24, 1}, {"SSBP", 20, 4}, {"AuxS", 4, 6}, {"CCdo", 12, 60}, {"CCdP", 16, 120},
+  {"RCPS", 52, 2}, {"MPCE", 4, 2}, {"MPSp", 4, 1}, {"MPfe", 56, 20}, {"MRPr", 8, 1}, {"MRcS", 48, 100}, {"PrgI", 4, 2},
+  {"PrvI", 4, 2}, {"TrSS", 12, 2}, {"TrPr", 4, 2}, {"TrPs", 8, 2}, {"TMxP", 4, 2}, {"TDpP", 4, 2}, {"TWpP", 20, 2},
+  {"TDvP", 12, 2}, {"TStP", 20, 2}, {"KeOn", 4, 8}, {"KeBP", 20, 8}, {"KeLm", 12, 8}, {"KACk", 16, 8}, {"KePt", 36, 8},
+  {"KeDV", 64, 8}, {"KeFS", 4, 8}, {"KKFP", 52, 16}, {"DskB", 8, 2}, {"DskP", 20, 2}, {"DskS", 8, 2}, {"FtbP", 4, 2},
+  {"FtbS", 4, 2}, {"ColV", 8, 2}, {"AMIP", 20, 24}, {"AMMO", 8, 1}, {"AMmO", 4, 1}, {"AMTl", 4, 1}, {"TlIn", 42, 1},
+  {"TlSr", 124, 1}, {"Time", 8, 1}, {"StRS", 4, 1}, {"InCm", 4, 1}
+};
+
+// Subclass, giving access to the receive buffer and parser of ATEMbase
+class ATEMminBenchmark : public ATEMmin {
+  public:
+    uint16_t fillPacket(uint16_t *commandIndex, uint8_t *occurrence, uint16_t *commands);
+    void parse(uint16_t packetLength) { _parsePacket(_receiveBuffer, packetLength); }
+};
+
+/**
+ * Fills the receive buffer with the next commands of the dump, as the switcher would pack them.
+ * Returns the packet length, or 0 when the whole dump has been packed.
+ */
+uint16_t ATEMminBenchmark::fillPacket(uint16_t *commandIndex, uint8_t *occurrence, uint16_t *commands) {
+  uint16_t length = 12;
+  *commands = 0;
+  memset(_receiveBuffer, 0, ATEM_receiveBufferLength);
+  while (*commandIndex < sizeof(initDump) / sizeof(initDump[0])) {
+    const DumpCommand &command = initDump[*commandIndex];
+    uint16_t cmdLength = 8 + command.dataLength;
+    if (length + cmdLength > (ATEM_receiveBufferLength < 1400 ? ATEM_receiveBufferLength : 1400)) break;
+
+    _receiveBuffer[length] = highByte(cmdLength);
+    _receiveBuffer[length + 1] = lowByte(cmdLength);
+    memcpy(_receiveBuffer + length + 4, command.name, 4);
+    length += cmdLength;
+    (*commands)++;
+
+    if (++(*occurrence) >= command.count) {
+      *occurrence = 0;
+      (*commandIndex)++;
+    }
+  }
+  return length > 12 ? length : 0;
+}
+
+ATEMminBenchmark AtemSwitcher;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("\n- - - - - - - -\nATEMmin parse benchmark"));
+
+  uint16_t commandIndex = 0;
+  uint8_t occurrence = 0;
+  uint16_t commands;
+  uint16_t packetLength;
+  uint16_t packets = 0;
+  unsigned long totalCommands = 0;
+  unsigned long totalMicros = 0;
+
+  while ((packetLength = AtemSwitcher.fillPacket(&commandIndex, &occurrence, &commands)) > 0) {
+    unsigned long start = micros();
+    for (uint16_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+      AtemSwitcher.parse(packetLength);
+    }
+    totalMicros += micros() - start;
+    totalCommands += (unsigned long)commands * BENCHMARK_ITERATIONS;
+    packets++;
+  }
+
+  Serial.print(F("Packets in dump: "));
+  Serial.println(packets);
+  Serial.print(F("Commands parsed: "));
+  Serial.println(totalCommands);
+  Serial.print(F("ns/command: "));
+  Serial.println((float)totalMicros * 1000.0 / totalCommands);
+}
+
+void loop() {
+}
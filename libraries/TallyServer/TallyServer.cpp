@@ -29,34 +29,72 @@ TallyServer::TallyServer() : TallyServer(TALLY_SERVER_DEFAULT_MAX_CLIENTS) { }
  * Construct TallyServer with a client capacity of maxClinents
  */
 TallyServer::TallyServer(int maxClients) {
-    #if defined ESP8266 || defined ESP32
-        WiFiUDP Udp;
-    #else
-        EthernetUDP Udp;
-    #endif
-
-    _udp = Udp;
+    _udp = &_defaultTransport;
 
+    maxClients = constrain(maxClients, 1, TALLY_SERVER_MAX_CLIENTS);
     _clients = new TallyServer::TallyClient[maxClients];
     _maxClients = maxClients;
+
+    //Clients are looked up by IP and port in a hash table at most half full, and connect to the free spots in _freeClients
+    uint16_t tableSize = 1;
+    while(tableSize < 2 * maxClients) tableSize <<= 1;
+    _clientTable = new uint16_t[tableSize];
+    _clientTableMask = tableSize - 1;
+    _freeClients = new uint16_t[maxClients];
+    _connectedClients = new uint16_t[maxClients];
+    _resetClients();
+
+    _atemTallySources = 0;
+    _tallyFlagsChanged = false;
+    resetTallyFlags();
+
+    _tallyDeltas = false;
+    _tallyStateSequence = 0;
+    _sentTallySources = 0;
+    memset(_sentTallyFlags, 0, TALLY_SERVER_MAX_TALLY_FLAGS);
+    memset(_tallyChanges, 0, sizeof(_tallyChanges));
+    _tallySourcesSequence = 0;
+    _deltasSent = 0;
+    _skippedUpdates = 0;
+
+    _fanOutPort = 0;
+    _fanOutSequence = 0;
+    _fanOutSentAt = 0;
+    _fanOuts = 0;
+    _fanOutRepairs = 0;
+    _resends = 0;
+}
+
+TallyServer::~TallyServer() {
+    delete[] _clients;
+    delete[] _clientTable;
+    delete[] _freeClients;
+    delete[] _connectedClients;
+}
+
+/**
+ * Use transport instead of the UDP of the board, e.g. a PosixUdpTransport. Call it before begin(). NULL goes back to the default.
+ */
+void TallyServer::setTransport(UdpTransport *transport) {
+    _udp = transport != NULL ? transport : &_defaultTransport;
 }
 
 /**
  * Begin tally server, letting other tally lights connect to it in runLoop()
  */
 void TallyServer::begin() {
-    for(int i = 0; i < _maxClients; i++) _resetClient(&_clients[i]);
+    _resetClients();
 
-    _udp.begin(9910);
+    _udp->begin(9910);
 }
 
 /**
  * Disable tally server, disconnecting all tally lights currently connected.
  */
 void TallyServer::end() {
-    _udp.stop();
+    _udp->stop();
 
-    for (int i = 0; i < _maxClients; i++) _resetClient(&_clients[i]);
+    _resetClients();
 }
 
 /** 
@@ -65,12 +103,12 @@ void TallyServer::end() {
 void TallyServer::runLoop() {
     // Handle incoming data    
     uint16_t packetSize = 0;
-    while ((packetSize = _udp.parsePacket()) > 0) {
-        if (_udp.available()) {
-            IPAddress remoteIP = _udp.remoteIP();
-            uint16_t remotePort = _udp.remotePort();
+    while ((packetSize = _udp->parsePacket()) > 0) {
+        if (_udp->available()) {
+            IPAddress remoteIP = _udp->remoteIP();
+            uint16_t remotePort = _udp->remotePort();
 
-            _udp.read(_buffer, 12);
+            _udp->read(_buffer, 12);
             uint8_t flags = _buffer[0] & 0b11111000;
             uint16_t packetLen = (_buffer[0] & 0b00000111) + _buffer[1];
             #if TALLY_SERVER_DEBUG >= 2
@@ -86,6 +124,17 @@ void TallyServer::runLoop() {
             if(packetSize == packetLen) { //If not then same something went wrong and we skip the packet.
                 TallyClient *client = _getTallyClient(remoteIP, remotePort);
 
+                if (client && client->_isInitialized && (flags & TALLY_SERVER_FLAG_HELLO)) { //Reconnecting from the port of its last session, e.g. the fan-out port. That session is over
+                    _resetClient(client);
+                    client = _getTallyClient(remoteIP, remotePort);
+                    #if TALLY_SERVER_DEBUG
+                    Serial.print(remoteIP);
+                    Serial.print(':');
+                    Serial.print(remotePort);
+                    Serial.println(" - Hello packet recieved from initialized client - new session");
+                    #endif
+                }
+
                 if (client) {
                     client->_sessionID = (_buffer[2] << 8) + _buffer[3];
                     uint16_t remotePacketID = (_buffer[10] << 8) + _buffer[11];
@@ -93,8 +142,20 @@ void TallyServer::runLoop() {
                     client->_lastRecv = millis();
 
                     if (client->_isInitialized) { //Handle initialized client
-                        if(flags & TALLY_SERVER_FLAG_ACK) {
-                            client->_lastAckedID = (_buffer[4] << 8) + _buffer[5];
+                        if((flags & TALLY_SERVER_FLAG_ACK_REQUEST) && packetLen > 12) _handleClientCommands(client, packetLen - 12);
+
+                        if(flags == 0) { //Ack of a fan-out. No need to send it tally data on its own anymore
+                            client->_getsFanOut = true;
+                            client->_fanOutAckedSequence = (_buffer[4] << 8) + _buffer[5];
+                            #if TALLY_SERVER_DEBUG > 1
+                            Serial.print(client->_tallyIP);
+                            Serial.print(':');
+                            Serial.print(client->_tallyPort);
+                            Serial.println(" - Fan-out ack recieved");
+                            #endif
+
+                        } if(flags & TALLY_SERVER_FLAG_ACK) {
+                            _handleAck(client, (_buffer[4] << 8) + _buffer[5]);
                             #if TALLY_SERVER_DEBUG > 1
                             Serial.print(client->_tallyIP);
                             Serial.print(':');
@@ -113,10 +174,22 @@ void TallyServer::runLoop() {
                             Serial.println(" - Ack resquest recieved - responded");
                             #endif
 
+                        } if(client->_wantsTallyState) { //It missed a delta
+                            uint16_t cmdLen = _createTallyData(client);
+                            _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen);
+                            _sendBuffer(client, cmdLen);
+                            _scheduleClient(client, client->_resendTimeout);
+                            client->_wantsTallyState = false;
+                            #if TALLY_SERVER_DEBUG
+                            Serial.print(client->_tallyIP);
+                            Serial.print(':');
+                            Serial.print(client->_tallyPort);
+                            Serial.println(" - Tally state requested - sent tally data");
+                            #endif
+
                         } if(flags & TALLY_SERVER_FLAG_RESEND_REQUEST) { //All we ever send is tally data... So let's just do that again.
                             uint16_t resendPacketID = (_buffer[6] << 8) + _buffer[7] + 1; //For some reason ATEMbase library subtracts one when requesting a resend - we add one back for it to work...
-                            _resetBuffer();
-                            uint16_t cmdLen = 12 + _createTallyDataCmd();
+                            uint16_t cmdLen = _createTallyData(client);
                             _createHeader(client, TALLY_SERVER_FLAG_RESENT_PACKAGE | TALLY_SERVER_FLAG_ACK | TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen, 0, resendPacketID);
                             _sendBuffer(client, cmdLen);
                             #if TALLY_SERVER_DEBUG
@@ -135,18 +208,17 @@ void TallyServer::runLoop() {
                                 Serial.print(client->_tallyPort);
                                 Serial.println(" - Resent package recieved - ignoring it.");
                             }
-                            if(flags & TALLY_SERVER_FLAG_HELLO) {
-                                Serial.print(client->_tallyIP);
-                                Serial.print(':');
-                                Serial.print(client->_tallyPort);
-                                Serial.println(" - Hello packet recieved - ignoring it.");
-                            }
                         #endif
 
                     } else if (client->_isConnected) { // Initialize new connection
                         if(flags & TALLY_SERVER_FLAG_ACK) {
-                            _resetBuffer();
-                            uint16_t cmdLen = 12 + _createTallyDataCmd();
+                            if(packetLen >= 20) { //Hello extension, telling what the client supports and the tally indexes it's subscribed to
+                                _udp->read(_buffer + 12, 8);
+                                client->_features = _buffer[12];
+                                _setTallySubscription(client, _buffer + 13);
+                            }
+
+                            uint16_t cmdLen = _createTallyData(client);
                             _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen);
                             _sendBuffer(client, cmdLen);
 
@@ -155,6 +227,7 @@ void TallyServer::runLoop() {
                             _sendBuffer(client, 12);
 
                             client->_isInitialized = true;
+                            _scheduleClient(client, client->_resendTimeout);
                             #if TALLY_SERVER_DEBUG
                             Serial.print(client->_tallyIP);
                             Serial.print(':');
@@ -174,11 +247,9 @@ void TallyServer::runLoop() {
 
                     } else { //New connection
                         if (flags & TALLY_SERVER_FLAG_HELLO) {//Respond to first hello packet.
-                            _resetBuffer();
-                            _createHeader(client, TALLY_SERVER_FLAG_HELLO, 20);
-                            _buffer[12] = TALLY_SERVER_CONNECTION_ACCEPTED;
-                            _sendBuffer(client, 20);
-                            client->_isConnected = true;
+                            _sendHello(client, TALLY_SERVER_CONNECTION_ACCEPTED);
+                            _connectClient(client);
+                            _scheduleClient(client, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL);
                             #if TALLY_SERVER_DEBUG
                             Serial.print(client->_tallyIP);
                             Serial.print(':');
@@ -198,13 +269,11 @@ void TallyServer::runLoop() {
                     }
                 } else { //No client means no empty spot
                     if (flags & TALLY_SERVER_FLAG_HELLO) { //Reject connection
-                        _resetBuffer();
-                        client = new TallyServer::TallyClient();
+                        TallyClient rejectedClient = TallyClient();
+                        client = &rejectedClient;
                         client->_tallyIP = remoteIP;
                         client->_tallyPort = remotePort;
-                        _createHeader(client, TALLY_SERVER_FLAG_HELLO, 20);
-                        _buffer[12] = TALLY_SERVER_CONNECTION_REJECTED;
-                        _sendBuffer(client, 20);
+                        _sendHello(client, TALLY_SERVER_CONNECTION_REJECTED);
                         #if TALLY_SERVER_DEBUG
                         Serial.print(client->_tallyIP);
                         Serial.print(':');
@@ -227,100 +296,220 @@ void TallyServer::runLoop() {
             }
             #endif
         }
-        _udp.flush();
+        _udp->flush();
     }
 
     if(_tallyFlagsChanged) { //Send new tally data to clients
-        //Reset buffer and construct tally data cmd. The cmd is the same for all clients
         #if TALLY_SERVER_DEBUG
         Serial.println("Sending new tally data to connected clients");
         #endif
+        _tallyStateSequence++;
+
+        uint64_t changed = 0; //Bitmask of the tally indexes changed since the tally data last sent
+        for(int i = 0; i < _atemTallySources; i++) {
+            if(_atemTallyFlags[i] != _sentTallyFlags[i]) changed |= 1ULL << i;
+        }
+        _tallyChanges[_tallyStateSequence & (TALLY_SERVER_TALLY_HISTORY - 1)] = changed;
+        if(_atemTallySources != _sentTallySources) _tallySourcesSequence = _tallyStateSequence;
+
+        //Reset buffer and construct tally data cmd. The cmd is the same for all clients with no tally data of their own
         _resetBuffer();
-        uint16_t cmdLen = 12 + _createTallyDataCmd();
+        uint16_t cmdLen = 12 + _createTallyDataCmd(_atemTallySources);
+
+        if(_fanOutPort > 0) _sendFanOut(cmdLen);
 
-        //We build a client specific header and send the packet, if it's initialized
-        for(int i = 0; i < _maxClients; i++) {
-            TallyClient *client = &_clients[i];
-            if(client->_isInitialized) {
+        //One pass over the connected clients. Initialized ones not getting the fan-out are sent the cmd with a client specific header,
+        //or what they need if they apply deltas or are subscribed to some tally indexes. That's built for each of them in the same buffer,
+        //so the cmd is built again for the next client that gets it
+        bool tallyDataCmdInBuffer = true;
+        for(uint16_t i = 0; i < _connectedClientCount; i++) {
+            TallyClient *client = &_clients[_connectedClients[i]];
+            if(!client->_isInitialized) continue;
+
+            if(client->_getsFanOut && _fanOutPort > 0) {
+                _scheduleClient(client, TALLY_SERVER_FAN_OUT_REPAIR_TIMEOUT);
+            } else if(_getsOwnTallyData(client)) {
+                _sendTallyUpdate(client, changed);
+                tallyDataCmdInBuffer = false;
+            } else {
+                if(!tallyDataCmdInBuffer) {
+                    _resetBuffer();
+                    _createTallyDataCmd(_atemTallySources);
+                    tallyDataCmdInBuffer = true;
+                }
                 _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen);
                 _sendBuffer(client, cmdLen);
+                _scheduleClient(client, client->_resendTimeout);
+                client->_tallySequence = _tallyStateSequence;
             }
         }
 
+        _sentTallySources = _atemTallySources;
+        memcpy(_sentTallyFlags, _atemTallyFlags, TALLY_SERVER_MAX_TALLY_FLAGS);
         _tallyFlagsChanged = false;
     }
 
-    /**
-     * Keep connections alive by requesting ACK packages form them wtih a given interval
-     */
-    for(int i = 0; i < _maxClients; i++) {
-        TallyClient *client = &_clients[i];
-        if(client->_isInitialized) {
-            if(client->_lastAckedID < client->_localPacketIdCounter && _hasTimePassed(client->_lastSend, 250)) {
-                _resetBuffer();
-                uint16_t cmdLen = 12 + _createTallyDataCmd();
-                _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen);
-                _sendBuffer(client, cmdLen);
-                #if TALLY_SERVER_DEBUG
-                Serial.print(client->_tallyIP);
-                Serial.print(':');
-                Serial.print(client->_tallyPort);
-                Serial.println(" - Ack not recieved - Resent tally data");
-                #endif
-
-            } else if(_hasTimePassed(client->_lastRecv, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL) && _hasTimePassed(client->_lastSend, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL)) {
-                _resetBuffer();
-                _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, 12);
-                _sendBuffer(client, 12);
-                #if TALLY_SERVER_DEBUG > 1
-                Serial.print(client->_tallyIP);
-                Serial.print(':');
-                Serial.print(client->_tallyPort);
-                Serial.println(" - Ack request sent");
-                #endif
-
-            } else if(_hasTimePassed(client->_lastRecv, 5000)) {
-                _resetClient(client);
-                #if TALLY_SERVER_DEBUG
-                Serial.print(client->_tallyIP);
-                Serial.print(':');
-                Serial.print(client->_tallyPort);
-                Serial.println(" - Client disconnected - Was initialized");
-                #endif
-            }
+    //Keep connections alive, resend what wasn't acked and drop clients gone silent, for the clients that have something due
+    _runTimers();
+}
 
-        } else if(client->_isConnected) {
-            if(_hasTimePassed(client->_lastSend, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL)) {
-                _resetBuffer();
-                _createHeader(client, TALLY_SERVER_FLAG_HELLO, 20);
-                _buffer[12] = TALLY_SERVER_CONNECTION_ACCEPTED;
-                _sendBuffer(client, 20);
-                #if TALLY_SERVER_DEBUG
-                Serial.print(client->_tallyIP);
-                Serial.print(':');
-                Serial.print(client->_tallyPort);
-                Serial.println(" - Resent hello packet to client");
-                #endif
-
-            } else if(_hasTimePassed(client->_lastRecv, 5000)) {
-                _resetClient(client);
-                #if TALLY_SERVER_DEBUG
-                Serial.print(client->_tallyIP);
-                Serial.print(':');
-                Serial.print(client->_tallyPort);
-                Serial.println(" - Client disconnected - Was not initialized");
-                #endif
-            }
+/**
+ * Keep the connection to a client alive by requesting ACK packages form it wtih a given interval, resend tally data it didn't ack,
+ * and drop it if it's gone silent. Called from the timer wheel when something may be due, after which it's scheduled for the next time.
+ */
+void TallyServer::_serviceClient(TallyClient *client) {
+    if(client->_isInitialized) {
+        if(client->_getsFanOut && _fanOutPort > 0 && client->_fanOutAckedSequence != _fanOutSequence && _hasTimePassed(_fanOutSentAt, TALLY_SERVER_FAN_OUT_REPAIR_TIMEOUT)) {
+            uint16_t cmdLen = _createTallyData(client);
+            _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen);
+            _sendBuffer(client, cmdLen);
+            client->_fanOutAckedSequence = _fanOutSequence; //It has the latest tally data now, and will ack it as usual
+            _fanOutRepairs++;
+            #if TALLY_SERVER_DEBUG
+            Serial.print(client->_tallyIP);
+            Serial.print(':');
+            Serial.print(client->_tallyPort);
+            Serial.println(" - Fan-out not acked - Sent tally data");
+            #endif
+
+        } else if(_isPacketIdAfter(client->_localPacketIdCounter, client->_lastAckedID) && _hasTimePassed(client->_lastRequestSentAt, client->_resendTimeout)) {
+            uint16_t cmdLen = _createTallyData(client);
+            _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen);
+            _sendBuffer(client, cmdLen);
+            client->_resendTimeout = min(2 * client->_resendTimeout, TALLY_SERVER_MAX_RESEND_TIMEOUT); //Back off until it acks again
+            _resends++;
+            #if TALLY_SERVER_DEBUG
+            Serial.print(client->_tallyIP);
+            Serial.print(':');
+            Serial.print(client->_tallyPort);
+            Serial.println(" - Ack not recieved - Resent tally data");
+            #endif
+
+        } else if(_hasTimePassed(client->_lastRecv, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL) && _hasTimePassed(client->_lastSend, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL)) {
+            _resetBuffer();
+            _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, 12);
+            _sendBuffer(client, 12);
+            #if TALLY_SERVER_DEBUG > 1
+            Serial.print(client->_tallyIP);
+            Serial.print(':');
+            Serial.print(client->_tallyPort);
+            Serial.println(" - Ack request sent");
+            #endif
+
+        } else if(_hasTimePassed(client->_lastRecv, TALLY_SERVER_CLIENT_TIMEOUT)) {
+            _resetClient(client);
+            #if TALLY_SERVER_DEBUG
+            Serial.print(client->_tallyIP);
+            Serial.print(':');
+            Serial.print(client->_tallyPort);
+            Serial.println(" - Client disconnected - Was initialized");
+            #endif
         }
+
+    } else if(client->_isConnected) {
+        if(_hasTimePassed(client->_lastSend, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL)) {
+            _sendHello(client, TALLY_SERVER_CONNECTION_ACCEPTED);
+            #if TALLY_SERVER_DEBUG
+            Serial.print(client->_tallyIP);
+            Serial.print(':');
+            Serial.print(client->_tallyPort);
+            Serial.println(" - Resent hello packet to client");
+            #endif
+
+        } else if(_hasTimePassed(client->_lastRecv, TALLY_SERVER_CLIENT_TIMEOUT)) {
+            _resetClient(client);
+            #if TALLY_SERVER_DEBUG
+            Serial.print(client->_tallyIP);
+            Serial.print(':');
+            Serial.print(client->_tallyPort);
+            Serial.println(" - Client disconnected - Was not initialized");
+            #endif
+        }
+    }
+
+    if(client->_isConnected) _scheduleClient(client, _timeUntilDue(client));
+}
+
+/**
+ * Time (ms) until something may be due for a client in _serviceClient()
+ */
+unsigned long TallyServer::_timeUntilDue(TallyClient *client) {
+    unsigned long until = _timeLeft(client->_lastRecv, TALLY_SERVER_CLIENT_TIMEOUT);
+    if(client->_isInitialized) {
+        until = min(until, max(_timeLeft(client->_lastRecv, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL), _timeLeft(client->_lastSend, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL)));
+        if(_isPacketIdAfter(client->_localPacketIdCounter, client->_lastAckedID)) until = min(until, _timeLeft(client->_lastRequestSentAt, client->_resendTimeout));
+        if(client->_getsFanOut && _fanOutPort > 0 && client->_fanOutAckedSequence != _fanOutSequence) until = min(until, _timeLeft(_fanOutSentAt, TALLY_SERVER_FAN_OUT_REPAIR_TIMEOUT));
+    } else {
+        until = min(until, _timeLeft(client->_lastSend, TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL));
     }
+    return until;
+}
+
+/**
+ * Service the clients in the slots of the timer wheel that have come up since the last call. If it's been more than a whole turn,
+ * every slot is serviced once.
+ */
+void TallyServer::_runTimers() {
+    unsigned long nowTick = millis() / TALLY_SERVER_TIMER_WHEEL_TICK;
+    if(nowTick - _wheelTick > TALLY_SERVER_TIMER_WHEEL_SLOTS) _wheelTick = nowTick - TALLY_SERVER_TIMER_WHEEL_SLOTS;
+
+    while(_wheelTick != nowTick) {
+        _wheelTick++;
+        uint16_t slot = _wheelTick & (TALLY_SERVER_TIMER_WHEEL_SLOTS - 1);
+        uint16_t index = _wheel[slot];
+        _wheel[slot] = TALLY_SERVER_NO_CLIENT; //Taken off as a whole, so clients can be scheduled again while servicing them
+        while(index != TALLY_SERVER_NO_CLIENT) {
+            TallyClient *client = &_clients[index];
+            index = client->_wheelNext;
+            client->_isScheduled = false;
+            _serviceClient(client);
+        }
+    }
+}
+
+/**
+ * Make sure client is serviced within delay (ms). If it's scheduled earlier already, nothing changes.
+ * Delays beyond a turn of the wheel are cut to it, and the client is scheduled again from there.
+ */
+void TallyServer::_scheduleClient(TallyClient *client, unsigned long delay) {
+    unsigned long due = millis() + delay;
+    if(client->_isScheduled) {
+        if((long)(client->_due - due) <= 0) return;
+        _unscheduleClient(client);
+    }
+
+    unsigned long dueTick = (due + TALLY_SERVER_TIMER_WHEEL_TICK - 1) / TALLY_SERVER_TIMER_WHEEL_TICK;
+    if((long)(dueTick - _wheelTick) <= 0) dueTick = _wheelTick + 1;
+    else if(dueTick - _wheelTick >= TALLY_SERVER_TIMER_WHEEL_SLOTS) dueTick = _wheelTick + TALLY_SERVER_TIMER_WHEEL_SLOTS - 1;
+
+    uint16_t slot = dueTick & (TALLY_SERVER_TIMER_WHEEL_SLOTS - 1);
+    uint16_t index = client - _clients;
+    client->_due = due;
+    client->_wheelSlot = slot;
+    client->_wheelPrev = TALLY_SERVER_NO_CLIENT;
+    client->_wheelNext = _wheel[slot];
+    if(_wheel[slot] != TALLY_SERVER_NO_CLIENT) _clients[_wheel[slot]]._wheelPrev = index;
+    _wheel[slot] = index;
+    client->_isScheduled = true;
+}
+
+/**
+ * Take client off the timer wheel
+ */
+void TallyServer::_unscheduleClient(TallyClient *client) {
+    if(!client->_isScheduled) return;
+
+    if(client->_wheelPrev != TALLY_SERVER_NO_CLIENT) _clients[client->_wheelPrev]._wheelNext = client->_wheelNext;
+    else _wheel[client->_wheelSlot] = client->_wheelNext;
+    if(client->_wheelNext != TALLY_SERVER_NO_CLIENT) _clients[client->_wheelNext]._wheelPrev = client->_wheelPrev;
+    client->_isScheduled = false;
 }
 
 /** 
- * Set the number of tally sources to send to clients. Must be less than TALLY_SERVER_MAX_TALLY_FLAGS.
+ * Set the number of tally sources to send to clients. More than TALLY_SERVER_MAX_TALLY_FLAGS are sent as that many.
  */
 void TallyServer::setTallySources(uint8_t tallySources) {
-    if(tallySources < TALLY_SERVER_MAX_TALLY_FLAGS)
-        _atemTallySources = tallySources;
+    _atemTallySources = tallySources < TALLY_SERVER_MAX_TALLY_FLAGS ? tallySources : TALLY_SERVER_MAX_TALLY_FLAGS; //Only the first ones are sent
 }
 
 /**
@@ -333,13 +522,150 @@ void TallyServer::setTallyFlag(uint8_t tallyIndex, uint8_t tallyFlag) {
     }
 }
 
+/**
+ * Send tally data to all clients at once with one datagram to address (a broadcast or multicast address) and port, instead of to each of them.
+ * Clients get it if they connect from that port. Those that acknowledge it are only sent tally data on their own if they miss one,
+ * others (e.g. clients listening on another port) get it on their own as before. A port of 0 turns it off again.
+ */
+void TallyServer::setFanOut(IPAddress address, uint16_t port) {
+    _fanOutIP = address;
+    _fanOutPort = port;
+}
+
+/**
+ * Send clients that support it (ATEMmin does) only the tally flags that changed, instead of all of them. The tally data sent
+ * otherwise is stamped with a sequence, which deltas follow on. A client that misses a delta asks for the whole tally data again.
+ */
+void TallyServer::setTallyDeltas(bool enabled) {
+    _tallyDeltas = enabled;
+}
+
+/**
+ * Get the number of tally deltas sent
+ */
+unsigned long TallyServer::getTallyDeltaCount() {
+    return _deltasSent;
+}
+
+/**
+ * Get the number of times a change of the tally flags wasn't sent to a client, as none of the tally indexes it's subscribed to changed
+ */
+unsigned long TallyServer::getSkippedUpdateCount() {
+    return _skippedUpdates;
+}
+
+/**
+ * Get the number of fan-out datagrams sent
+ */
+unsigned long TallyServer::getFanOutCount() {
+    return _fanOuts;
+}
+
+/**
+ * Get the number of times a client missed a fan-out, and was sent the tally data on its own
+ */
+unsigned long TallyServer::getFanOutRepairCount() {
+    return _fanOutRepairs;
+}
+
+/**
+ * Reset buffer and build the tally data for client in it, stamped with the tally state if deltas are on,
+ * and return the packets length.
+ */
+uint16_t TallyServer::_createTallyData(TallyClient *client) {
+    _resetBuffer();
+    client->_tallySequence = _tallyStateSequence;
+    return 12 + _createTallyDataCmd(_clientTallySources(client, _atemTallySources));
+}
+
+/**
+ * Whether client is sent tally data of its own when the tally flags change, as it applies deltas or is subscribed to some tally indexes
+ */
+bool TallyServer::_getsOwnTallyData(TallyClient *client) {
+    return client->_tallySubscription != 0 || (_tallyDeltas && (client->_features & TALLY_SERVER_FEATURE_TALLY_DELTA));
+}
+
+/**
+ * Send a client what it needs of a change of the tally flags, changed being the bitmask of tally indexes changed:
+ * nothing if none it's subscribed to changed, a delta if it applies them and that's shorter, and otherwise
+ * the tally data up to its highest subscribed index.
+ */
+void TallyServer::_sendTallyUpdate(TallyClient *client, uint64_t changed) {
+    uint16_t sources = _clientTallySources(client, _atemTallySources);
+    bool sourcesChanged = sources != _clientTallySources(client, _sentTallySources);
+    if(client->_tallySubscription != 0) changed &= client->_tallySubscription;
+    if(changed == 0 && !sourcesChanged) { //Nothing it needs changed
+        _skippedUpdates++;
+        return;
+    }
+
+    _resetBuffer();
+    uint16_t cmdLen = 0;
+    if(_tallyDeltas && (client->_features & TALLY_SERVER_FEATURE_TALLY_DELTA) && !sourcesChanged && _canSendTallyDelta(client)) {
+        //Made against the state it acked rather than the one last sent, so a lost delta is made up for by the next one
+        uint64_t changes = _tallyChangesSince(client->_ackedTallySequence);
+        if(client->_tallySubscription != 0) changes &= client->_tallySubscription;
+        cmdLen = _createTallyDeltaCmd(changes, client->_ackedTallySequence, sources);
+    }
+    if(cmdLen > 0) _deltasSent++;
+    else cmdLen = _createTallyDataCmd(sources);
+    cmdLen += 12;
+
+    _createHeader(client, TALLY_SERVER_FLAG_ACK_REQUEST, cmdLen);
+    _sendBuffer(client, cmdLen);
+    _scheduleClient(client, client->_resendTimeout);
+    client->_tallySequence = _tallyStateSequence;
+}
+
+/**
+ * Whether client can be sent a delta against the tally state it acked: it has acked one, the number of tally sources
+ * hasn't changed since (only TlIn tells it), and the changes since are still in the history.
+ */
+bool TallyServer::_canSendTallyDelta(TallyClient *client) {
+    uint16_t age = _tallyStateSequence - client->_ackedTallySequence;
+    return client->_hasAckedTallyState && age <= TALLY_SERVER_TALLY_HISTORY && (uint16_t)(_tallyStateSequence - _tallySourcesSequence) >= age;
+}
+
+/**
+ * Bitmask of the tally indexes changed in the tally states after sequence, up to the current one
+ */
+uint64_t TallyServer::_tallyChangesSince(uint16_t sequence) {
+    uint64_t changes = 0;
+    for(uint16_t s = sequence + 1; s != (uint16_t)(_tallyStateSequence + 1); s++) {
+        changes |= _tallyChanges[s & (TALLY_SERVER_TALLY_HISTORY - 1)];
+    }
+    return changes;
+}
+
+/**
+ * Number of tally sources to send client, when there are sources of them: up to its highest subscribed index, if it has subscribed
+ */
+uint16_t TallyServer::_clientTallySources(TallyClient *client, uint16_t sources) {
+    return client->_tallySubscription != 0 ? min(sources, (uint16_t)client->_subscribedSources) : sources;
+}
+
+/**
+ * Set the tally indexes client is subscribed to from a bitmask of TALLY_SERVER_SUBSCRIPTION_LENGTH bytes,
+ * index 0 being the lowest bit of the first. No bits set (or none below TALLY_SERVER_MAX_TALLY_FLAGS) means all.
+ */
+void TallyServer::_setTallySubscription(TallyClient *client, const uint8_t *bitmask) {
+    client->_tallySubscription = 0;
+    client->_subscribedSources = 0;
+    for(int i = 0; i < TALLY_SERVER_MAX_TALLY_FLAGS; i++) {
+        if(bitmask[i / 8] & (1 << (i % 8))) {
+            client->_tallySubscription |= 1ULL << i;
+            client->_subscribedSources = i + 1;
+        }
+    }
+}
+
 /**
  * Build tally by index commant in the command buffer
- * based on _atemTallySources and _atemTallyFlags, and
+ * based on the first sources of _atemTallyFlags, and
  * return the commands length.
  */
-uint16_t TallyServer::_createTallyDataCmd() {
-    uint16_t cmdLen = 10 + _atemTallySources; //header = 8 + 2 (num sources) + *num sources*
+uint16_t TallyServer::_createTallyDataCmd(uint16_t sources) {
+    uint16_t cmdLen = 10 + sources; //header = 8 + 2 (num sources) + *num sources*
 
     //Cmd Length
     _buffer[12] = cmdLen >> 8;
@@ -354,40 +680,245 @@ uint16_t TallyServer::_createTallyDataCmd() {
     _buffer[19] = 'n';
     
     //Number of tally sources
-    _buffer[20] = _atemTallySources >> 8;
-    _buffer[21] = _atemTallySources;
+    _buffer[20] = sources >> 8;
+    _buffer[21] = sources;
 
     //Tally flag for each source
-    for(int i = 0; i < _atemTallySources; i++) {
+    for(int i = 0; i < sources; i++) {
         _buffer[22 + i] = _atemTallyFlags[i];
     }
 
+    if(_tallyDeltas) { //Stamp it with the state sequence, so clients know which delta follows on it
+        uint16_t stamp = 12 + cmdLen;
+        _buffer[stamp + 1] = 14;
+        _buffer[stamp + 4] = 'T';
+        _buffer[stamp + 5] = 'l';
+        _buffer[stamp + 6] = 'D';
+        _buffer[stamp + 7] = 'l';
+        _buffer[stamp + 8] = _tallyStateSequence >> 8;
+        _buffer[stamp + 9] = _tallyStateSequence;
+        _buffer[stamp + 13] = TALLY_SERVER_TALLY_DELTA_FULL_STATE;
+        cmdLen += 14;
+    }
+
+    return cmdLen;
+}
+
+/**
+ * Build tally delta command in the command buffer with the index and flag of each of the first sources of _atemTallyFlags
+ * in changed, leading from the tally state baseSequence to the current one, and return the commands length.
+ * 0 if it isn't shorter than the whole tally data.
+ */
+uint16_t TallyServer::_createTallyDeltaCmd(uint64_t changed, uint16_t baseSequence, uint16_t sources) {
+    uint16_t cmdLen = 14; //header = 8 + 2 (sequence) + 2 (base sequence) + 1 (num changes) + 1 (flags) + 2 per change
+    for(int i = 0; i < sources; i++) {
+        if(changed & (1ULL << i)) {
+            if(cmdLen + 2 >= 24 + sources) return 0; //TlIn with its stamp
+            _buffer[12 + cmdLen] = i;
+            _buffer[13 + cmdLen] = _atemTallyFlags[i];
+            cmdLen += 2;
+        }
+    }
+
+    //Cmd Length
+    _buffer[12] = cmdLen >> 8;
+    _buffer[13] = cmdLen;
+
+    //Cmd name
+    _buffer[16] = 'T';
+    _buffer[17] = 'l';
+    _buffer[18] = 'D';
+    _buffer[19] = 'l';
+
+    //Sequence of the tally state it leads to and the one it applies to, and number of changes
+    _buffer[20] = _tallyStateSequence >> 8;
+    _buffer[21] = _tallyStateSequence;
+    _buffer[22] = baseSequence >> 8;
+    _buffer[23] = baseSequence;
+    _buffer[24] = (cmdLen - 14) / 2;
+
     return cmdLen;
 }
 
+/**
+ * Read the commands following the header of a packet from a client, and note the ones known:
+ * TlRq asks for the whole tally data, and TlSb sets the tally indexes it's subscribed to.
+ * Commands not fitting in the buffer are ignored.
+ */
+void TallyServer::_handleClientCommands(TallyClient *client, uint16_t length) {
+    int readLength = _udp->read(_buffer + 12, min(length, (uint16_t)(TALLY_SERVER_BUFFER_LENGTH - 12)));
+    if(readLength <= 0) return;
+
+    uint16_t offset = 12;
+    while(offset + 8 <= 12 + readLength) {
+        uint16_t cmdLen = (_buffer[offset] << 8) + _buffer[offset + 1];
+        if(cmdLen < 8 || offset + cmdLen > 12 + readLength) break;
+
+        if(memcmp(_buffer + offset + 4, "TlRq", 4) == 0) client->_wantsTallyState = true;
+        if(memcmp(_buffer + offset + 4, "TlSb", 4) == 0 && cmdLen >= 8 + TALLY_SERVER_SUBSCRIPTION_LENGTH) {
+            _setTallySubscription(client, _buffer + offset + 8);
+            client->_wantsTallyState = true; //Newly subscribed indexes may not be up to date
+        }
+        offset += cmdLen;
+    }
+}
+
+/**
+ * Send a hello packet with the result of a connection attempt. It's marked as coming from a TallyServer,
+ * so clients can tell what they support in their ack to it.
+ */
+void TallyServer::_sendHello(TallyClient *client, uint8_t result) {
+    _resetBuffer();
+    _createHeader(client, TALLY_SERVER_FLAG_HELLO, 20);
+    _buffer[12] = result;
+    _buffer[16] = 'T';
+    _buffer[17] = 'S';
+    _sendBuffer(client, 20);
+}
+
+/**
+ * Handle an ack from an initialized client. Acks are cumulative, so everything up to and including ackedID has arrived.
+ * The round trip time of the packet being timed is measured if it's the one acked (as in RFC 6298), and the resend timeout derived from it.
+ */
+void TallyServer::_handleAck(TallyClient *client, uint16_t ackedID) {
+    if(!_isPacketIdAfter(ackedID, client->_lastAckedID)) return; //Old or repeated ack
+    client->_lastAckedID = ackedID;
+    if(!_isPacketIdAfter(client->_tallyPacketID, ackedID)) { //Acks are cumulative, so it has the tally state last sent
+        client->_hasAckedTallyState = true;
+        client->_ackedTallySequence = client->_tallySequence;
+    }
+
+    if(client->_isTiming && !_isPacketIdAfter(client->_timedPacketID, ackedID)) {
+        if(client->_timedPacketID == ackedID) {
+            uint16_t rtt = millis() - client->_timedSentAt;
+            if(client->_srtt8 == 0) {
+                client->_srtt8 = (rtt << 3) | 1; //Never 0 once measured
+                client->_rttvar4 = rtt << 1;
+            } else {
+                int16_t delta = rtt - (client->_srtt8 >> 3);
+                client->_srtt8 += delta;
+                if(delta < 0) delta = -delta;
+                client->_rttvar4 += delta - (client->_rttvar4 >> 2);
+            }
+            uint16_t timeout = (client->_srtt8 >> 3) + (client->_rttvar4 > 0 ? client->_rttvar4 : 1);
+            client->_rto = constrain(timeout, TALLY_SERVER_MIN_RESEND_TIMEOUT, TALLY_SERVER_MAX_RESEND_TIMEOUT);
+        }
+        client->_isTiming = false; //Acked past it, so the round trip can't be told
+    }
+    client->_resendTimeout = client->_rto; //It's acking again, so no more backing off
+}
+
+/**
+ * Wrap-safe comparison of 15 bit packet IDs. True if packetID is later than otherPacketID,
+ * i.e. less than half the ID range ahead of it.
+ */
+bool TallyServer::_isPacketIdAfter(uint16_t packetID, uint16_t otherPacketID) {
+    uint16_t distance = (packetID - otherPacketID) & (TALLY_SERVER_MAX_PACKET_ID - 1);
+    return distance != 0 && distance < (TALLY_SERVER_MAX_PACKET_ID >> 1);
+}
+
+/**
+ * Get the number of times tally data was resent to a client that didn't ack it in time
+ */
+unsigned long TallyServer::getResendCount() {
+    return _resends;
+}
+
+/**
+ * Get the number of clients connected
+ */
+uint16_t TallyServer::getClientCount() {
+    return _connectedClientCount;
+}
+
+/**
+ * Get the current resend timeout (ms) of the client with the given IP and port, 0 if it isn't connected
+ */
+uint16_t TallyServer::getResendTimeout(IPAddress clientIP, uint16_t clientPort) {
+    TallyClient *client = _findTallyClient(clientIP, clientPort);
+    return client != NULL ? client->_resendTimeout : 0;
+}
+
 /**
  * Get the client struct with the given IP and Port. If no match, a disconnected spot is
  * returned with the given IP and Port. If no disconnected spots are availabel, NULL is returned.
  */
 TallyServer::TallyClient *TallyServer::_getTallyClient(IPAddress clientIP, uint16_t clientPort) {
-    int8_t emptySpot = -1;
-    for (int i = 0; i < _maxClients; i++) {
-        if (_clients[i]._isConnected && _clients[i]._tallyIP == clientIP && _clients[i]._tallyPort == clientPort) {
-            return &_clients[i];
-        } else if (emptySpot < 0 && !_clients[i]._isConnected) {
-            emptySpot = i;
-        }
-    }
+    TallyClient *client = _findTallyClient(clientIP, clientPort);
+    if(client) return client;
 
-    if (emptySpot >= 0) {
-        _clients[emptySpot]._tallyIP = clientIP;
-        _clients[emptySpot]._tallyPort = clientPort;
-        return &_clients[emptySpot];
+    if(_freeClientCount > 0) { //The spot is only taken from _freeClients when connecting, see _connectClient()
+        client = &_clients[_freeClients[_freeClientCount - 1]];
+        client->_tallyIP = clientIP;
+        client->_tallyPort = clientPort;
+        return client;
     }
 
     return NULL;
 }
 
+/**
+ * Get the connected client with the given IP and Port, NULL if there's none
+ */
+TallyServer::TallyClient *TallyServer::_findTallyClient(IPAddress clientIP, uint16_t clientPort) {
+    for(uint16_t slot = _clientTableSlot(clientIP, clientPort); _clientTable[slot] != TALLY_SERVER_NO_CLIENT; slot = (slot + 1) & _clientTableMask) {
+        TallyClient *client = &_clients[_clientTable[slot]];
+        if(client->_tallyIP == clientIP && client->_tallyPort == clientPort) return client;
+    }
+    return NULL;
+}
+
+/**
+ * Home slot in _clientTable of the client with the given IP and port
+ */
+uint16_t TallyServer::_clientTableSlot(IPAddress clientIP, uint16_t clientPort) {
+    uint32_t key = (uint32_t)clientIP ^ ((uint32_t)clientPort << 16 | clientPort);
+    return (uint16_t)((key * 2654435769UL) >> 16) & _clientTableMask;
+}
+
+/**
+ * Mark the disconnected spot last returned by _getTallyClient() as connected, so it's found by its IP and port from now on
+ */
+void TallyServer::_connectClient(TallyClient *client) {
+    uint16_t slot = _clientTableSlot(client->_tallyIP, client->_tallyPort);
+    while(_clientTable[slot] != TALLY_SERVER_NO_CLIENT) slot = (slot + 1) & _clientTableMask;
+    _clientTable[slot] = client - _clients;
+
+    _freeClientCount--;
+    client->_connectedIndex = _connectedClientCount;
+    _connectedClients[_connectedClientCount++] = client - _clients;
+    client->_isConnected = true;
+}
+
+/**
+ * Remove a connected client from _clientTable and _connectedClients, and give its spot back to _freeClients. Entries after it are shifted back
+ * into the gap where needed, so lookups never stop early at it.
+ */
+void TallyServer::_disconnectClient(TallyClient *client) {
+    uint16_t index = client - _clients;
+    uint16_t slot = _clientTableSlot(client->_tallyIP, client->_tallyPort);
+    while(_clientTable[slot] != index) slot = (slot + 1) & _clientTableMask;
+
+    uint16_t next = slot;
+    while(true) {
+        next = (next + 1) & _clientTableMask;
+        if(_clientTable[next] == TALLY_SERVER_NO_CLIENT) break;
+        TallyClient *other = &_clients[_clientTable[next]];
+        uint16_t home = _clientTableSlot(other->_tallyIP, other->_tallyPort);
+        if(((next - home) & _clientTableMask) >= ((next - slot) & _clientTableMask)) { //Its home isn't between the gap and it, so it can move to the gap
+            _clientTable[slot] = _clientTable[next];
+            slot = next;
+        }
+    }
+    _clientTable[slot] = TALLY_SERVER_NO_CLIENT;
+
+    _freeClients[_freeClientCount++] = index;
+    uint16_t last = _connectedClients[--_connectedClientCount]; //The last connected one takes its place
+    _connectedClients[client->_connectedIndex] = last;
+    _clients[last]._connectedIndex = client->_connectedIndex;
+    client->_isConnected = false;
+}
+
 /**
  * _createHeader without remotePacketID and and resendPacketID
  */
@@ -409,7 +940,13 @@ void TallyServer::_createHeader(TallyClient *client, uint8_t flags, uint16_t len
     _buffer[5] = remotePacketID;            //Remote Packet ID
 
     if(flags & TALLY_SERVER_FLAG_ACK_REQUEST && !(flags & (TALLY_SERVER_FLAG_RESENT_PACKAGE | TALLY_SERVER_FLAG_RESEND_REQUEST | TALLY_SERVER_FLAG_HELLO ))) {
-        client->_localPacketIdCounter++;    //Increase local packet ID on new Ack request
+        client->_localPacketIdCounter = (client->_localPacketIdCounter + 1) % TALLY_SERVER_MAX_PACKET_ID; //Increase local packet ID on new Ack request
+        client->_lastRequestSentAt = millis();
+        if(!client->_isTiming) { //Time its round trip, if none is being timed
+            client->_isTiming = true;
+            client->_timedPacketID = client->_localPacketIdCounter;
+            client->_timedSentAt = client->_lastRequestSentAt;
+        }
 
         _buffer[10] = client->_localPacketIdCounter >> 8;   //Local Packet ID
         _buffer[11] = client->_localPacketIdCounter;        //Local Packet ID
@@ -426,10 +963,31 @@ void TallyServer::_createHeader(TallyClient *client, uint8_t flags, uint16_t len
     _buffer[11] = resendPacketID;
 }
 
+/**
+ * Send length of the tally data in the buffer as a fan-out. It has no flags and no session,
+ * and is numbered by a sequence of its own in the place of the local packet ID.
+ */
+void TallyServer::_sendFanOut(uint16_t length) {
+    _fanOutSequence = (_fanOutSequence + 1) & 0x7FFF;
+    if(_fanOutSequence == 0) _fanOutSequence = 1; //0 is for no fan-out sent yet
+
+    _buffer[0] = (length >> 8) & 0b00000111;    //No flags + length
+    _buffer[1] = length;                        //Length
+    _buffer[10] = _fanOutSequence >> 8;         //Sequence
+    _buffer[11] = _fanOutSequence;              //Sequence
+
+    _sendBuffer(_fanOutIP, _fanOutPort, length);
+    _fanOutSentAt = millis();
+    _fanOuts++;
+}
+
 /**
  * Send length of what's in the buffer to the given client.
  */
 void TallyServer::_sendBuffer(TallyClient *client, uint8_t length) {
+    if(length > 12 && (_buffer[0] & TALLY_SERVER_FLAG_ACK_REQUEST) && !(_buffer[0] & TALLY_SERVER_FLAG_RESENT_PACKAGE)) { //All we send with a payload is tally data
+        client->_tallyPacketID = (_buffer[10] << 8) + _buffer[11];
+    }
     _sendBuffer(client->_tallyIP, client->_tallyPort, length);
     client->_lastSend = millis();
 }
@@ -438,9 +996,9 @@ void TallyServer::_sendBuffer(TallyClient *client, uint8_t length) {
  * Send length of what's in the buffer to the given IP and Port
  */
 void TallyServer::_sendBuffer(IPAddress ip, uint16_t port, uint8_t length) {
-    _udp.beginPacket(ip, port);
-    _udp.write(_buffer, length);
-    _udp.endPacket();
+    _udp->beginPacket(ip, port);
+    _udp->write(_buffer, length);
+    _udp->endPacket();
 }
 
 /**
@@ -454,12 +1012,55 @@ void TallyServer::_resetBuffer() {
  * Reset given client struct, so that it's ready for a new client connecting
  */
 void TallyServer::_resetClient(TallyClient *client) {
-    client->_isConnected = false;
+    if(client->_isConnected) _disconnectClient(client);
+    _unscheduleClient(client);
     client->_isInitialized = false;
     client->_lastRecv = 0;
     client->_localPacketIdCounter = 0;
+    client->_lastAckedID = 0;
+    client->_isTiming = false;
+    client->_srtt8 = 0;
+    client->_rttvar4 = 0;
+    client->_rto = TALLY_SERVER_INITIAL_RESEND_TIMEOUT;
+    client->_resendTimeout = TALLY_SERVER_INITIAL_RESEND_TIMEOUT;
     client->_lastRemotePacketID = 0;
     client->_sessionID = 0;
+    client->_getsFanOut = false;
+    client->_fanOutAckedSequence = 0;
+    client->_features = 0;
+    client->_wantsTallyState = false;
+    client->_tallySubscription = 0;
+    client->_subscribedSources = 0;
+    client->_tallySequence = 0;
+    client->_tallyPacketID = 0;
+    client->_hasAckedTallyState = false;
+    client->_ackedTallySequence = 0;
+}
+
+/**
+ * Reset all client structs, the hash table and the timer wheel, so all spots are free
+ */
+void TallyServer::_resetClients() {
+    memset(_clientTable, 0xFF, (_clientTableMask + 1) * sizeof(uint16_t)); //TALLY_SERVER_NO_CLIENT
+    for(uint16_t i = 0; i < TALLY_SERVER_TIMER_WHEEL_SLOTS; i++) _wheel[i] = TALLY_SERVER_NO_CLIENT;
+    _wheelTick = millis() / TALLY_SERVER_TIMER_WHEEL_TICK;
+
+    _freeClientCount = 0;
+    _connectedClientCount = 0;
+    for(int i = _maxClients - 1; i >= 0; i--) {
+        _clients[i]._isConnected = false;
+        _clients[i]._isScheduled = false;
+        _resetClient(&_clients[i]);
+        _freeClients[_freeClientCount++] = i; //Lowest spot first
+    }
+}
+
+/**
+ * Time (ms) left of an interval since the given timestamp, 0 if it has passed
+ */
+unsigned long TallyServer::_timeLeft(unsigned long timestamp, uint16_t interval) {
+    unsigned long passed = (unsigned long)millis() - timestamp;
+    return passed >= interval ? 0 : interval - passed;
 }
 
 /**
@@ -22,11 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #define TALLY_SERVER_DEBUG 0
 
-#if defined ESP8266 || defined ESP32
-#include <WiFiUdp.h>
-#else
-#include <EthernetUdp.h>
-#endif
+#include <UdpTransport.h>
 
 #define TALLY_SERVER_FLAG_ACK               0b10000000
 #define TALLY_SERVER_FLAG_RESEND_REQUEST    0b01000000
@@ -39,47 +35,127 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define TALLY_SERVER_CONNECTION_REJECTED    3
 #define TALLY_SERVER_CONNECTION_LOST        4
 
-#define TALLY_SERVER_MAX_TALLY_FLAGS    41
+#define TALLY_SERVER_SUBSCRIPTION_LENGTH    7    //Bytes of the bitmask of tally indexes a client subscribes to, in the hello extension and TlSb
+#define TALLY_SERVER_MAX_TALLY_FLAGS    (8 * TALLY_SERVER_SUBSCRIPTION_LENGTH) //As many as clients can subscribe to. At most 64, the bits of the masks of tally indexes
 
-#define TALLY_SERVER_BUFFER_LENGTH  62 //Max 42: Header = 12 + cmdHeader = 8 + tallySources = 2 + max 40 tally flags
+#define TALLY_SERVER_BUFFER_LENGTH  92 //Header = 12 + cmdHeader = 8 + tallySources = 2 + max 56 tally flags + TlDl stamp = 14
 
 #define TALLY_SERVER_DEFAULT_MAX_CLIENTS    5
+#define TALLY_SERVER_MAX_CLIENTS            1024
+#define TALLY_SERVER_NO_CLIENT              0xFFFF
+
+#define TALLY_SERVER_MAX_PACKET_ID  0x8000  //Packet IDs are 15 bit
 
 #define TALLY_SERVER_KEEP_ALIVE_MSG_INTERVAL 1500
+#define TALLY_SERVER_INITIAL_RESEND_TIMEOUT 250 //Time (ms) a client has to ack tally data before it's resent, until its round trip time is measured
+#define TALLY_SERVER_MIN_RESEND_TIMEOUT 20      //Lower bound of the resend timeout (ms)
+#define TALLY_SERVER_MAX_RESEND_TIMEOUT 1000    //Upper bound of the resend timeout (ms)
+#define TALLY_SERVER_CLIENT_TIMEOUT 5000        //Time (ms) without anything from a client before it's dropped
+
+#define TALLY_SERVER_TIMER_WHEEL_SLOTS 64       //Must be a power of 2
+#define TALLY_SERVER_TIMER_WHEEL_TICK 25        //Time (ms) per slot, so the wheel reaches 1.6 s ahead
+
+#define TALLY_SERVER_FAN_OUT_PORT 9911           //Suggested port for fan-out, see setFanOut()
+#define TALLY_SERVER_FAN_OUT_REPAIR_TIMEOUT 100  //Time (ms) a client has to acknowledge a fan-out, before it's sent the tally data on its own
+
+#define TALLY_SERVER_FEATURE_TALLY_DELTA    0x01 //Client applies TlDl tally deltas, told in the hello extension of its ack to our hello
+#define TALLY_SERVER_TALLY_DELTA_FULL_STATE 0x01 //TlDl flag: stamps the TlIn before it with the state sequence, instead of carrying changes
+#define TALLY_SERVER_TALLY_HISTORY          16   //Tally states whose changes are kept, so deltas can apply to the last one a client acked. Must be a power of 2
 
 class TallyServer {
 private:
-#if defined ESP8266 || defined ESP32
-    WiFiUDP _udp;
-#else
-    EthernetUDP _udp;
-#endif
+    DefaultUdpTransport _defaultTransport;
+    UdpTransport *_udp;
 
     struct TallyClient {
         IPAddress _tallyIP;
         uint16_t _tallyPort;
         bool _isConnected;
+        uint16_t _connectedIndex;       //Where it is in _connectedClients, when connected
         bool _isInitialized;
         uint16_t _localPacketIdCounter;
         uint16_t _sessionID;
         unsigned long _lastRecv;
         unsigned long _lastSend;
         uint16_t _lastAckedID;
+        unsigned long _lastRequestSentAt; //Time (millis) the latest packet to be acked was sent
+        uint16_t _srtt8;                //Smoothed round trip time (ms) scaled by 8, 0 when not measured yet
+        uint16_t _rttvar4;              //Round trip time variation (ms) scaled by 4
+        uint16_t _rto;                  //Resend timeout (ms) from the round trip time
+        uint16_t _resendTimeout;        //Resend timeout (ms) now, _rto doubled on every resend until acked
+        bool _isTiming;                 //Timing the round trip of _timedPacketID
+        uint16_t _timedPacketID;
+        unsigned long _timedSentAt;
         uint16_t _lastRemotePacketID;
+        bool _getsFanOut;               //Has acknowledged a fan-out, so it's left out when sending tally data to each client
+        uint16_t _fanOutAckedSequence;
+        uint8_t _features;              //TALLY_SERVER_FEATURE_* bits from the hello extension
+        bool _wantsTallyState;          //Asked for the whole tally state with TlRq, after missing a delta
+        uint64_t _tallySubscription;    //Bitmask of the tally indexes it wants, 0 for all
+        uint8_t _subscribedSources;     //Tally sources up to its highest subscribed index
+        uint16_t _tallySequence;        //Tally state last sent to it
+        uint16_t _tallyPacketID;        //Packet ID it was last sent tally data in
+        bool _hasAckedTallyState;
+        uint16_t _ackedTallySequence;   //Tally state it has acked, that a delta to it applies to
+        bool _isScheduled;              //On the timer wheel, in the list of _wheelSlot
+        uint16_t _wheelSlot;
+        uint16_t _wheelPrev;
+        uint16_t _wheelNext;
+        unsigned long _due;             //Time (millis) it was scheduled for
     };
 
     uint8_t _buffer[TALLY_SERVER_BUFFER_LENGTH];
 
     TallyClient* _clients;
     int _maxClients = 0; 
+    uint16_t *_clientTable;             //Indexes of connected clients in _clients, by a hash of IP and port with linear probing
+    uint16_t _clientTableMask;
+    uint16_t *_freeClients;             //Indexes of disconnected spots in _clients
+    int _freeClientCount;
+    uint16_t *_connectedClients;        //Indexes of connected spots in _clients, in no particular order
+    uint16_t _connectedClientCount;
+
+    uint16_t _wheel[TALLY_SERVER_TIMER_WHEEL_SLOTS];  //Lists of clients to service, by the tick they're due
+    unsigned long _wheelTick;                           //The last tick serviced
 
     uint16_t _atemTallySources;
     uint8_t _atemTallyFlags[TALLY_SERVER_MAX_TALLY_FLAGS];
     bool _tallyFlagsChanged;
 
-    TallyClient *_getTallyClient(IPAddress clientIP, uint16_t clientPort);
+    bool _tallyDeltas;                  //Send clients that support it only what changed, see setTallyDeltas()
+    uint16_t _tallyStateSequence;       //Counts the tally states sent
+    uint16_t _sentTallySources;
+    uint8_t _sentTallyFlags[TALLY_SERVER_MAX_TALLY_FLAGS];  //The tally state last sent
+    uint64_t _tallyChanges[TALLY_SERVER_TALLY_HISTORY];     //Bitmask of the tally indexes changed to get to each of the latest tally states, by sequence
+    uint16_t _tallySourcesSequence;     //Tally state the number of tally sources last changed in
+    unsigned long _deltasSent;
+    unsigned long _skippedUpdates;
+
+    IPAddress _fanOutIP;
+    uint16_t _fanOutPort;               //0 if fan-out is off
+    uint16_t _fanOutSequence;
+    unsigned long _fanOutSentAt;
+    unsigned long _fanOuts;
+    unsigned long _fanOutRepairs;
+    unsigned long _resends;
 
-    uint16_t _createTallyDataCmd();
+    TallyClient *_getTallyClient(IPAddress clientIP, uint16_t clientPort);
+    TallyClient *_findTallyClient(IPAddress clientIP, uint16_t clientPort);
+    uint16_t _clientTableSlot(IPAddress clientIP, uint16_t clientPort);
+    void _connectClient(TallyClient *client);
+    void _disconnectClient(TallyClient *client);
+
+    uint16_t _createTallyData(TallyClient *client);
+    uint16_t _createTallyDataCmd(uint16_t sources);
+    uint16_t _createTallyDeltaCmd(uint64_t changed, uint16_t baseSequence, uint16_t sources);
+    bool _canSendTallyDelta(TallyClient *client);
+    uint64_t _tallyChangesSince(uint16_t sequence);
+    bool _getsOwnTallyData(TallyClient *client);
+    void _sendTallyUpdate(TallyClient *client, uint64_t changed);
+    uint16_t _clientTallySources(TallyClient *client, uint16_t sources);
+    void _setTallySubscription(TallyClient *client, const uint8_t *bitmask);
+    void _handleClientCommands(TallyClient *client, uint16_t length);
+    void _sendHello(TallyClient *client, uint8_t result);
     
     void _createHeader(TallyClient *client, uint8_t falgs, uint16_t lengthOfData);
     void _createHeader(TallyClient *client, uint8_t falgs, uint16_t lengthOfData, uint16_t remotePacketID);
@@ -91,16 +167,40 @@ private:
     void _resetBuffer();
 
     void _resetClient(TallyClient *client);
+    void _resetClients();
+
+    void _serviceClient(TallyClient *client);
+    unsigned long _timeUntilDue(TallyClient *client);
+    void _runTimers();
+    void _scheduleClient(TallyClient *client, unsigned long delay);
+    void _unscheduleClient(TallyClient *client);
+
+    void _sendFanOut(uint16_t length);
+
+    void _handleAck(TallyClient *client, uint16_t ackedID);
+    bool _isPacketIdAfter(uint16_t packetID, uint16_t otherPacketID);
 
     bool _hasTimePassed(unsigned long timestamp, uint16_t interval);
+    unsigned long _timeLeft(unsigned long timestamp, uint16_t interval);
 
 public:
     TallyServer();
     TallyServer(int maxClients);
+    ~TallyServer();
+    void setTransport(UdpTransport *transport);
     void begin();
     void end();
     void runLoop();
     void setTallySources(uint8_t tallySources);
     void setTallyFlag(uint8_t tallyIndex, uint8_t tallyFlag);
     void resetTallyFlags();
+    void setFanOut(IPAddress address, uint16_t port);
+    unsigned long getFanOutCount();
+    unsigned long getFanOutRepairCount();
+    unsigned long getResendCount();
+    uint16_t getClientCount();
+    uint16_t getResendTimeout(IPAddress clientIP, uint16_t clientPort);
+    void setTallyDeltas(bool enabled);
+    unsigned long getTallyDeltaCount();
+    unsigned long getSkippedUpdateCount();
 };
@@ -0,0 +1,149 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the UdpTransport library for use with Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client libraries for Arduino, and the TallyServer library.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "UdpTransport.h"
+
+#if !(defined ESP8266 || defined ESP32 || defined ARDUINO)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+PosixUdpTransport::PosixUdpTransport() {
+    _socket = -1;
+    _rxLength = 0;
+    _rxPosition = 0;
+    _txLength = 0;
+}
+
+PosixUdpTransport::~PosixUdpTransport() {
+    stop();
+}
+
+/**
+ * Opens a non-blocking socket bound to port on all interfaces, which may send to broadcast addresses. Returns 1 on success, 0 otherwise.
+ */
+uint8_t PosixUdpTransport::begin(uint16_t port) {
+    stop();
+
+    _socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_socket < 0) return 0;
+
+    int reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    int broadcast = 1;  // For the fan-out of TallyServer, which WiFiUDP and EthernetUDP allow anyway
+    setsockopt(_socket, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+    fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL, 0) | O_NONBLOCK);
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(_socket, (sockaddr *)&local, sizeof(local)) < 0) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void PosixUdpTransport::stop() {
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+    _rxLength = 0;
+    _rxPosition = 0;
+}
+
+/**
+ * Receives the next datagram, if any. Returns its size, or 0 if there was none.
+ */
+int PosixUdpTransport::parsePacket() {
+    _rxLength = 0;
+    _rxPosition = 0;
+    if (_socket < 0) return 0;
+
+    socklen_t remoteLength = sizeof(_remote);
+    ssize_t length = recvfrom(_socket, _rxBuffer, sizeof(_rxBuffer), 0, (sockaddr *)&_remote, &remoteLength);
+    if (length <= 0) return 0;
+
+    _rxLength = length;
+    return _rxLength;
+}
+
+int PosixUdpTransport::available() {
+    return _rxLength - _rxPosition;
+}
+
+int PosixUdpTransport::read(uint8_t *buffer, size_t length) {
+    int remaining = available();
+    if (remaining <= 0) return -1;
+
+    if (length > (size_t)remaining) length = remaining;
+    memcpy(buffer, _rxBuffer + _rxPosition, length);
+    _rxPosition += length;
+    return length;
+}
+
+IPAddress PosixUdpTransport::remoteIP() {
+    const uint8_t *address = (const uint8_t *)&_remote.sin_addr.s_addr;
+    return IPAddress(address[0], address[1], address[2], address[3]);
+}
+
+uint16_t PosixUdpTransport::remotePort() {
+    return ntohs(_remote.sin_port);
+}
+
+/**
+ * Discards the rest of the current datagram
+ */
+void PosixUdpTransport::flush() {
+    _rxPosition = _rxLength;
+}
+
+int PosixUdpTransport::beginPacket(IPAddress ip, uint16_t port) {
+    memset(&_destination, 0, sizeof(_destination));
+    _destination.sin_family = AF_INET;
+    uint8_t *address = (uint8_t *)&_destination.sin_addr.s_addr;
+    for (uint8_t i = 0; i < 4; i++) address[i] = ip[i];
+    _destination.sin_port = htons(port);
+    _txLength = 0;
+    return 1;
+}
+
+size_t PosixUdpTransport::write(const uint8_t *buffer, size_t length) {
+    if (length > sizeof(_txBuffer) - _txLength) length = sizeof(_txBuffer) - _txLength;
+    memcpy(_txBuffer + _txLength, buffer, length);
+    _txLength += length;
+    return length;
+}
+
+/**
+ * Sends the datagram. Returns 1 on success, 0 otherwise.
+ */
+int PosixUdpTransport::endPacket() {
+    if (_socket < 0) return 0;
+
+    ssize_t sent = sendto(_socket, _txBuffer, _txLength, 0, (sockaddr *)&_destination, sizeof(_destination));
+    return sent == (ssize_t)_txLength ? 1 : 0;
+}
+#endif
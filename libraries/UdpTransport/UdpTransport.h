@@ -0,0 +1,127 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This file is a part of the UdpTransport library for use with Kasper Skårhøj's
+(<https://skaarhoj.com>) ATEM client libraries for Arduino, and the TallyServer library.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef UdpTransport_h
+#define UdpTransport_h
+
+#include "Arduino.h"
+
+#if defined ESP8266 || defined ESP32
+#include <WiFiUdp.h>
+#elif defined ARDUINO
+#include <EthernetUdp.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#define UDP_TRANSPORT_BUFFER_LENGTH 1500	// Largest datagram the POSIX transport sends or receives
+
+/**
+ * The UDP operations the ATEM libraries and TallyServer use, so the network can be swapped.
+ * Mirrors the Arduino UDP class, so a WiFiUDP or EthernetUDP can be wrapped without changes.
+ */
+class UdpTransport {
+public:
+    virtual ~UdpTransport() {}
+
+    virtual uint8_t begin(uint16_t port) = 0;
+    virtual void stop() = 0;
+
+    virtual int parsePacket() = 0;
+    virtual int available() = 0;
+    virtual int read(uint8_t *buffer, size_t length) = 0;
+    virtual IPAddress remoteIP() = 0;
+    virtual uint16_t remotePort() = 0;
+    virtual void flush() = 0;
+
+    virtual int beginPacket(IPAddress ip, uint16_t port) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t length) = 0;
+    virtual int endPacket() = 0;
+};
+
+#if defined ESP8266 || defined ESP32 || defined ARDUINO
+/**
+ * Transport through the UDP class of the board, WiFiUDP or EthernetUDP
+ */
+class ArduinoUdpTransport : public UdpTransport {
+private:
+#if defined ESP8266 || defined ESP32
+    WiFiUDP _udp;
+#else
+    EthernetUDP _udp;
+#endif
+
+public:
+    uint8_t begin(uint16_t port) { return _udp.begin(port); }
+    void stop() { _udp.stop(); }
+
+    int parsePacket() { return _udp.parsePacket(); }
+    int available() { return _udp.available(); }
+    int read(uint8_t *buffer, size_t length) { return _udp.read(buffer, length); }
+    IPAddress remoteIP() { return _udp.remoteIP(); }
+    uint16_t remotePort() { return _udp.remotePort(); }
+    void flush() { _udp.flush(); }
+
+    int beginPacket(IPAddress ip, uint16_t port) { return _udp.beginPacket(ip, port); }
+    size_t write(const uint8_t *buffer, size_t length) { return _udp.write(buffer, length); }
+    int endPacket() { return _udp.endPacket(); }
+};
+
+typedef ArduinoUdpTransport DefaultUdpTransport;
+#else
+/**
+ * Transport through a non-blocking POSIX UDP socket, for running the libraries as a normal process on Linux (or macOS)
+ */
+class PosixUdpTransport : public UdpTransport {
+private:
+    int _socket;
+
+    uint8_t _rxBuffer[UDP_TRANSPORT_BUFFER_LENGTH];
+    int _rxLength;
+    int _rxPosition;
+    sockaddr_in _remote;
+
+    uint8_t _txBuffer[UDP_TRANSPORT_BUFFER_LENGTH];
+    size_t _txLength;
+    sockaddr_in _destination;
+
+public:
+    PosixUdpTransport();
+    ~PosixUdpTransport();
+
+    uint8_t begin(uint16_t port);
+    void stop();
+
+    int parsePacket();
+    int available();
+    int read(uint8_t *buffer, size_t length);
+    IPAddress remoteIP();
+    uint16_t remotePort();
+    void flush();
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t *buffer, size_t length);
+    int endPacket();
+};
+
+typedef PosixUdpTransport DefaultUdpTransport;
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Arduino.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+
+HostSerial Serial;
+
+static uint64_t monotonicMicros() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static const uint64_t startMicros = monotonicMicros();
+
+/**
+ * Time since start, wrapping like on the boards
+ */
+unsigned long millis() {
+    return (uint32_t)((monotonicMicros() - startMicros) / 1000);
+}
+
+unsigned long micros() {
+    return (uint32_t)(monotonicMicros() - startMicros);
+}
+
+void delay(unsigned long ms) {
+    timespec duration = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000 };
+    nanosleep(&duration, NULL);
+}
+
+void yield() {
+    sched_yield();
+}
+
+long random(long howBig) {
+    return howBig <= 0 ? 0 : rand() % howBig;
+}
+
+long random(long howSmall, long howBig) {
+    return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed) {
+    srand(seed);
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size--) written += write(*buffer++);
+    return written;
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+    char digits[8 * sizeof(long) + 1];
+    char *str = &digits[sizeof(digits) - 1];
+    *str = '\0';
+    if (base < 2) base = 10;
+    do {
+        uint8_t digit = n % base;
+        n /= base;
+        *--str = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    } while (n);
+    return write(str);
+}
+
+size_t Print::print(long n, int base) {
+    if (base == 10 && n < 0) return write((uint8_t)'-') + printNumber(-(unsigned long)n, 10);
+    return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+    char str[32];
+    snprintf(str, sizeof(str), "%.*f", digits, n);
+    return write(str);
+}
+
+size_t IPAddress::printTo(Print &p) const {
+    size_t n = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        if (i > 0) n += p.print('.');
+        n += p.print(_address[i], DEC);
+    }
+    return n;
+}
+
+size_t HostSerial::write(uint8_t c) {
+    return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
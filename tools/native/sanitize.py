@@ -0,0 +1,4 @@
+# Links with the sanitizers given in build_flags, which PlatformIO only passes to the compiler
+Import("env")
+
+env.Append(LINKFLAGS=[flag for flag in env["CCFLAGS"] if flag.startswith("-fsanitize=")])
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+Connects to a switcher with ATEMmin and serves its tally to tally lights with TallyServer, like a tally light does, as a normal process.
+Tally changes are printed.
+
+Usage: bridge <switcher IP> [--record <capture file>] [--fan-out <address>] [--tally-deltas] [--verbose]
+	--record	Record the session with the switcher (see ATEMcapture.h), e.g. for the replay tool
+	--fan-out	Send tally changes to all tally lights at once, to this broadcast or multicast address (see TallyServer::setFanOut())
+	--tally-deltas	Send tally lights that support it only the tally flags that changed (see TallyServer::setTallyDeltas())
+	--verbose	Serial output of ATEMbase
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+#include <ATEMbase.h>
+#include <ATEMmin.h>
+#include <TallyServer.h>
+
+static volatile bool running = true;
+
+static void stopRunning(int) {
+	running = false;
+}
+
+int main(int argc, char **argv) {
+	const char *switcher = NULL;
+	const char *recordPath = NULL;
+	const char *fanOut = NULL;
+	bool tallyDeltas = false;
+	bool verbose = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) recordPath = argv[++i];
+		else if (strcmp(argv[i], "--fan-out") == 0 && i + 1 < argc) fanOut = argv[++i];
+		else if (strcmp(argv[i], "--tally-deltas") == 0) tallyDeltas = true;
+		else if (strcmp(argv[i], "--verbose") == 0) verbose = true;
+		else switcher = argv[i];
+	}
+
+	in_addr address;
+	in_addr fanOutAddress;
+	if (switcher == NULL || inet_pton(AF_INET, switcher, &address) != 1 || (fanOut != NULL && inet_pton(AF_INET, fanOut, &fanOutAddress) != 1)) {
+		fprintf(stderr, "Usage: %s <switcher IP> [--record <capture file>] [--fan-out <address>] [--tally-deltas] [--verbose]\n", argv[0]);
+		return 2;
+	}
+
+	signal(SIGINT, stopRunning);
+	signal(SIGTERM, stopRunning);
+	randomSeed(micros());
+
+	ATEMmin atemSwitcher;
+	ATEMfileRecorder recorder;
+	atemSwitcher.begin(IPAddress((const uint8_t *)&address.s_addr));
+	if (verbose) atemSwitcher.serialOutput(1);
+	if (recordPath != NULL) {
+		if (!recorder.open(recordPath)) {
+			perror(recordPath);
+			return 1;
+		}
+		atemSwitcher.setRecorder(&recorder);
+	}
+
+	TallyServer tallyServer;
+	tallyServer.begin();
+	if (fanOut != NULL) tallyServer.setFanOut(IPAddress((const uint8_t *)&fanOutAddress.s_addr), TALLY_SERVER_FAN_OUT_PORT);
+	tallyServer.setTallyDeltas(tallyDeltas);
+
+	uint8_t tally[ATEM_maxTallySources];
+	memset(tally, 0, sizeof(tally));
+	bool wasInitialized = false;
+
+	while (running) {
+		atemSwitcher.runLoop();
+
+		if (atemSwitcher.hasInitialized() != wasInitialized) {
+			wasInitialized = atemSwitcher.hasInitialized();
+			printf(wasInitialized ? "Connected to switcher, initialized in %lu ms\n" : "Connection to switcher lost\n", atemSwitcher.getInitDuration());
+			if (!wasInitialized) tallyServer.resetTallyFlags();
+		}
+
+		uint8_t tallySources = atemSwitcher.getTallyByIndexSources();
+		tallyServer.setTallySources(tallySources);
+		for (uint8_t i = 0; i < tallySources && i < ATEM_maxTallySources; i++) {
+			uint8_t flags = atemSwitcher.getTallyByIndexTallyFlags(i);
+			tallyServer.setTallyFlag(i, flags);
+			if (flags != tally[i]) {
+				printf("Tally %d: %s%s\n", i + 1, flags & 1 ? "program " : "", flags & 2 ? "preview" : (flags ? "" : "off"));
+				tally[i] = flags;
+			}
+		}
+		fflush(stdout);
+
+		tallyServer.runLoop();
+		delay(1);
+	}
+
+	if (fanOut != NULL) printf("Fan-outs sent %lu, missed by a tally light %lu times\n", tallyServer.getFanOutCount(), tallyServer.getFanOutRepairCount());
+	if (tallyDeltas) printf("Tally deltas sent %lu\n", tallyServer.getTallyDeltaCount());
+	tallyServer.end();
+	recorder.close();
+	return 0;
+}
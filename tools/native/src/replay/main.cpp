@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+Replays a capture (see ATEMcapture.h) through ATEMmin and prints how fast it was parsed.
+
+Usage: replay <capture file> [--realtime] [--filter] [--iterations <n>]
+	--realtime		Keep the recorded time between datagrams, instead of going as fast as possible
+	--filter		Only parse the commands the tally light needs, like ATEM_tally_light does
+	--iterations	Replay the capture n times, each into a new client (default 1)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <ATEMbase.h>
+#include <ATEMmin.h>
+
+const uint32_t tallyCommandFilter[] = { ATEM_fourCC('T', 'l', 'I', 'n'), ATEM_fourCC('S', 't', 'R', 'S'), ATEM_fourCC('_', 'p', 'i', 'n') };
+
+int main(int argc, char **argv) {
+	const char *path = NULL;
+	bool realTime = false;
+	bool filter = false;
+	unsigned long iterations = 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--realtime") == 0) realTime = true;
+		else if (strcmp(argv[i], "--filter") == 0) filter = true;
+		else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = strtoul(argv[++i], NULL, 10);
+		else path = argv[i];
+	}
+	if (path == NULL || iterations == 0) {
+		fprintf(stderr, "Usage: %s <capture file> [--realtime] [--filter] [--iterations <n>]\n", argv[0]);
+		return 2;
+	}
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		perror(path);
+		return 1;
+	}
+	std::vector<uint8_t> capture;
+	uint8_t chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) capture.insert(capture.end(), chunk, chunk + read);
+	fclose(file);
+
+	ATEMreplay replay(capture.data(), capture.size());
+	if (!replay.isValid()) {
+		fprintf(stderr, "%s is not a capture\n", path);
+		return 1;
+	}
+
+	uint64_t datagrams = 0, bytes = 0, micros = 0, commands = 0;
+	for (unsigned long i = 0; i < iterations; i++) {
+		ATEMmin client;
+		if (filter) client.begin(IPAddress(127, 0, 0, 1), tallyCommandFilter, sizeof(tallyCommandFilter) / sizeof(tallyCommandFilter[0]));
+		else client.begin(IPAddress(127, 0, 0, 1));
+
+		ATEMreplayResult result = replay.run(client, realTime);
+		if (!result.valid) {
+			fprintf(stderr, "%s is cut off or malformed\n", path);
+			return 1;
+		}
+		datagrams += result.datagrams;
+		bytes += result.bytes;
+		micros += result.elapsedMicros;
+		commands += client.getParsedCommandCount() + client.getSkippedCommandCount();
+
+		if (i == 0) {
+			printf("Initialized: %s, tally sources: %d, parsed: %lu, skipped: %lu\n", client.hasInitialized() ? "yes" : "no",
+				client.getTallyByIndexSources(), client.getParsedCommandCount(), client.getSkippedCommandCount());
+		}
+	}
+
+	printf("%llu datagrams, %llu bytes, %llu commands in %llu us\n", (unsigned long long)datagrams, (unsigned long long)bytes, (unsigned long long)commands, (unsigned long long)micros);
+	if (micros > 0 && commands > 0) {
+		printf("%.1f ns/command, %.1f MB/s\n", micros * 1000.0 / commands, bytes / (double)micros);
+	}
+	return 0;
+}
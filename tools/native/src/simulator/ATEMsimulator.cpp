@@ -0,0 +1,462 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ATEMsimulator.h"
+
+/**
+ * Constructor. All history is allocated up front, so nothing is allocated while serving.
+ */
+ATEMsimulator::ATEMsimulator(const ATEMsimulatorConfig &config) {
+	_config = config;
+	_config.maxSessions = max<uint16_t>(_config.maxSessions, 1);
+	_config.initPackets = max<uint16_t>(_config.initPackets, 1);
+	_config.initPacketSize = constrain(_config.initPacketSize, 12, SIMULATOR_maxPacketLength);
+	_config.tallySources = constrain(_config.tallySources, 2, SIMULATOR_maxTallySources);
+	_config.lossPercent = min<uint8_t>(_config.lossPercent, 100);
+
+	_udp = &_defaultTransport;
+
+	_historyLength = _config.initPackets + 1 + SIMULATOR_historyMargin;
+	_sessions = new Session[_config.maxSessions];
+	for (uint16_t i = 0; i < _config.maxSessions; i++) {
+		_sessions[i]._history = new uint8_t[(size_t)_historyLength * SIMULATOR_maxPacketLength];
+		_sessions[i]._historyPacketIds = new uint16_t[_historyLength];
+		_sessions[i]._historyLengths = new uint16_t[_historyLength];
+		_sessions[i]._historySentAt = new unsigned long[_historyLength];
+		_sessions[i]._historyRetransmits = new uint8_t[_historyLength];
+		_resetSession(&_sessions[i]);
+	}
+	_nextSessionId = 1;
+
+	memset(&_stats, 0, sizeof(_stats));
+
+	_programSource = 0;
+	_previewSource = 1;
+	_streamingStatus = 1;	// Idle
+	_updates = 0;
+}
+
+ATEMsimulator::~ATEMsimulator() {
+	for (uint16_t i = 0; i < _config.maxSessions; i++) {
+		delete[] _sessions[i]._history;
+		delete[] _sessions[i]._historyPacketIds;
+		delete[] _sessions[i]._historyLengths;
+		delete[] _sessions[i]._historySentAt;
+		delete[] _sessions[i]._historyRetransmits;
+	}
+	delete[] _sessions;
+}
+
+/**
+ * Use transport instead of a POSIX socket. Call it before begin(). NULL goes back to the default.
+ */
+void ATEMsimulator::setTransport(UdpTransport *transport) {
+	_udp = transport != NULL ? transport : &_defaultTransport;
+}
+
+/**
+ * Starts listening for clients on port (ATEMbase always talks to 9910). Returns false if the port couldn't be opened.
+ */
+bool ATEMsimulator::begin(uint16_t port) {
+	for (uint16_t i = 0; i < _config.maxSessions; i++) _resetSession(&_sessions[i]);
+	_nextUpdateAt = micros();
+	return _udp->begin(port);
+}
+
+/**
+ * Stops listening, dropping all sessions without telling the clients, like a switcher being switched off
+ */
+void ATEMsimulator::end() {
+	_udp->stop();
+	for (uint16_t i = 0; i < _config.maxSessions; i++) _resetSession(&_sessions[i]);
+}
+
+/**
+ * Handles incoming datagrams, sends updates when they are due, sends packages again that weren't acknowledged, and keeps sessions alive or drops them.
+ * Returns true if there was anything to do, so the caller can sleep otherwise.
+ */
+bool ATEMsimulator::runLoop() {
+	bool busy = false;
+
+	int packetSize;
+	for (uint16_t i = 0; i < 256 && (packetSize = _udp->parsePacket()) > 0; i++) {	// Bounded, so a flood of clients can't hold up updates
+		busy = true;
+		_stats.datagramsIn++;
+		if (packetSize <= SIMULATOR_maxPacketLength && _udp->read(_buffer, packetSize) == packetSize) {
+			_handleDatagram(packetSize);
+		} else {
+			_stats.malformed++;
+		}
+		_udp->flush();
+	}
+
+	if (_config.updateRate > 0) {
+		unsigned long interval = 1000000UL / _config.updateRate;
+		unsigned long now = micros();
+		if ((long)(now - _nextUpdateAt) >= 0) {
+			_sendUpdate();
+			_nextUpdateAt += interval;
+			if ((long)(now - _nextUpdateAt) > 1000000L) _nextUpdateAt = now + interval;	// Fell far behind, don't try to catch up with a burst
+			busy = true;
+		}
+	}
+
+	unsigned long now = millis();
+	for (uint16_t i = 0; i < _config.maxSessions; i++) {
+		Session *session = &_sessions[i];
+		if (!session->_active) continue;
+
+		if (now - session->_lastRecv > _config.sessionTimeout) {
+			_resetSession(session);
+			_stats.sessionsTimedOut++;
+		} else if (session->_initialized) {
+			_retransmitPackages(session);
+			if (now - session->_lastSend >= SIMULATOR_keepAliveInterval) _sendPackage(session, _payload, 0);
+		}
+	}
+
+	return busy;
+}
+
+uint16_t ATEMsimulator::getSessionCount() {
+	uint16_t sessions = 0;
+	for (uint16_t i = 0; i < _config.maxSessions; i++) {
+		if (_sessions[i]._active) sessions++;
+	}
+	return sessions;
+}
+
+const ATEMsimulatorStats &ATEMsimulator::getStats() {
+	return _stats;
+}
+
+/**
+ * Handles the datagram of length bytes in _buffer
+ */
+void ATEMsimulator::_handleDatagram(uint16_t length) {
+	uint8_t flags = _buffer[0] & 0b11111000;
+	uint16_t packetLength = word(_buffer[0] & 0b00000111, _buffer[1]);
+	if (length < 12 || length != packetLength) {
+		_stats.malformed++;
+		return;
+	}
+
+	IPAddress remoteIP = _udp->remoteIP();
+	uint16_t remotePort = _udp->remotePort();
+	uint16_t remotePacketID = word(_buffer[10], _buffer[11]);
+	Session *session = _getSession(remoteIP, remotePort);
+
+	if (flags & TALLY_SERVER_FLAG_HELLO) {
+		if (session == NULL) {	// New client, if there's room
+			for (uint16_t i = 0; i < _config.maxSessions && session == NULL; i++) {
+				if (!_sessions[i]._active) session = &_sessions[i];
+			}
+		}
+
+		Session reply;
+		if (session != NULL) {	// A known client saying hello again has restarted, so it starts over
+			_resetSession(session);
+			session->_active = true;
+			session->_ip = remoteIP;
+			session->_port = remotePort;
+			session->_lastRecv = millis();
+		} else {
+			session = &reply;
+			session->_ip = remoteIP;
+			session->_port = remotePort;
+		}
+
+		session->_sessionId = word(_buffer[2], _buffer[3]);	// The hello is answered in the session ID of the client, after that the switcher assigns one
+		memset(_buffer, 0, 20);
+		_createHeader(session, TALLY_SERVER_FLAG_HELLO, 20, 0);
+		_buffer[12] = session == &reply ? TALLY_SERVER_CONNECTION_REJECTED : TALLY_SERVER_CONNECTION_ACCEPTED;
+		_sendBuffer(session, _buffer, 20);
+
+		if (session == &reply) {
+			_stats.sessionsRejected++;
+		} else {
+			session->_sessionId = 0x8000 | _nextSessionId;
+			_nextSessionId = (_nextSessionId + 1) & 0x7FFF;
+			_stats.sessionsAccepted++;
+		}
+		return;
+	}
+
+	if (session == NULL) return;	// Not a client we know, and not saying hello
+	session->_lastRecv = millis();
+
+	if (!session->_initialized) {	// The acknowledge of our hello ends the handshake
+		if (flags & TALLY_SERVER_FLAG_ACK) _sendInitDump(session);
+		return;
+	}
+
+	if (flags & TALLY_SERVER_FLAG_ACK) _handleAck(session, word(_buffer[4], _buffer[5]));
+
+	if (flags & TALLY_SERVER_FLAG_ACK_REQUEST) {	// Commands from the client, or it checking that we are still here
+		if (length > 12) _stats.commandsReceived++;
+		memset(_buffer, 0, 12);
+		_createHeader(session, TALLY_SERVER_FLAG_ACK, 12, remotePacketID);
+		_sendBuffer(session, _buffer, 12);
+	}
+
+	if (flags & TALLY_SERVER_FLAG_RESEND_REQUEST) {	// ATEMbase asks for the package after the one it names
+		uint16_t packetId = (word(_buffer[6], _buffer[7]) + 1) & 0x7FFF;
+		uint16_t slot = packetId % _historyLength;
+		if (session->_historyPacketIds[slot] == packetId && session->_historyLengths[slot] > 0) {
+			_resendPackage(session, slot);
+			_stats.resendRequestsServed++;
+		} else {
+			_stats.resendRequestsMissed++;
+		}
+	}
+}
+
+/**
+ * Sends the state of the switcher in initPackets packages of initPacketSize, followed by an empty package, which tells ATEMbase the dump is complete.
+ * The first package holds the version, product name and topology, the last one the tally state. The rest is made up of filler commands, which ATEMmin skips.
+ */
+void ATEMsimulator::_sendInitDump(Session *session) {
+	uint16_t payloadSize = _config.initPacketSize - 12;
+	for (uint16_t p = 1; p <= _config.initPackets; p++) {
+		uint16_t position = 0;
+		if (p == 1) {
+			const uint8_t version[4] = {0, 2, 0, 30};
+			position = _appendCommand(_payload, position, "_ver", version, sizeof(version));
+			char product[44];
+			memset(product, 0, sizeof(product));
+			strncpy(product, "ATEM 1 M/E Production Switcher (simulated)", sizeof(product) - 1);
+			position = _appendCommand(_payload, position, "_pin", (const uint8_t *)product, sizeof(product));
+			uint8_t topology[20];	// 1 M/E, the sources, 2 colors, 1 aux, 2 DSKs, 1 stinger, 1 DVE
+			memset(topology, 0, sizeof(topology));
+			topology[0] = 1;
+			topology[1] = _config.tallySources;
+			topology[2] = 2;
+			topology[3] = 1;
+			topology[4] = 2;
+			topology[5] = 1;
+			topology[6] = 1;
+			position = _appendCommand(_payload, position, "_top", topology, sizeof(topology));
+			uint8_t tallyConfig[8];
+			memset(tallyConfig, 0, sizeof(tallyConfig));
+			tallyConfig[4] = _config.tallySources;
+			position = _appendCommand(_payload, position, "_TlC", tallyConfig, sizeof(tallyConfig));
+		}
+		if (p == _config.initPackets) {
+			position = _appendState(_payload, position);
+			const uint8_t initComplete[4] = {1, 0, 0, 0};
+			position = _appendCommand(_payload, position, "InCm", initComplete, sizeof(initComplete));
+		}
+		if (position + 8 < payloadSize) {
+			position = _appendCommand(_payload, position, "SmFl", NULL, payloadSize - position - 8);
+		}
+		_sendPackage(session, _payload, position);
+	}
+	_sendPackage(session, _payload, 0);
+
+	session->_initialized = true;
+	_stats.initDumpsSent++;
+}
+
+/**
+ * Cuts to the preview source, moves preview on to the next one, and sends the new state to all sessions.
+ * Every 10th update the streaming status changes as well.
+ */
+void ATEMsimulator::_sendUpdate() {
+	_updates++;
+	_programSource = _previewSource;
+	_previewSource = (_previewSource + 1) % _config.tallySources;
+	if (_updates % 10 == 0) _streamingStatus = _streamingStatus == 1 ? 4 : 1;	// Idle, streaming
+
+	uint16_t position = _appendState(_payload, 0);
+	for (uint16_t i = 0; i < _config.maxSessions; i++) {
+		Session *session = &_sessions[i];
+		if (session->_active && session->_initialized) {
+			_sendPackage(session, _payload, position);
+			_stats.updatesSent++;
+		}
+	}
+}
+
+/**
+ * Appends a command to payload at position. With data NULL, the command is filled with zeros.
+ * Returns the position after it, or position if there's no room for it.
+ */
+uint16_t ATEMsimulator::_appendCommand(uint8_t *payload, uint16_t position, const char *name, const uint8_t *data, uint16_t length) {
+	uint16_t cmdLength = 8 + length;
+	if (position + cmdLength > SIMULATOR_maxPacketLength - 12) return position;
+
+	uint8_t *cmd = payload + position;
+	cmd[0] = highByte(cmdLength);
+	cmd[1] = lowByte(cmdLength);
+	cmd[2] = 0;
+	cmd[3] = 0;
+	memcpy(cmd + 4, name, 4);
+	if (data != NULL) memcpy(cmd + 8, data, length);
+	else memset(cmd + 8, 0, length);
+	return position + cmdLength;
+}
+
+/**
+ * Appends PrgI, PrvI, TlIn and StRS of the current state. Source IDs are the input numbers, the index in TlIn + 1.
+ */
+uint16_t ATEMsimulator::_appendState(uint8_t *payload, uint16_t position) {
+	const uint8_t program[4] = {0, 0, 0, (uint8_t)(_programSource + 1)};
+	position = _appendCommand(payload, position, "PrgI", program, sizeof(program));
+
+	const uint8_t preview[8] = {0, 0, 0, (uint8_t)(_previewSource + 1), 0, 0, 0, 0};
+	position = _appendCommand(payload, position, "PrvI", preview, sizeof(preview));
+
+	uint8_t tally[2 + SIMULATOR_maxTallySources];
+	memset(tally, 0, sizeof(tally));
+	tally[1] = _config.tallySources;
+	tally[2 + _programSource] |= 1;
+	tally[2 + _previewSource] |= 2;
+	position = _appendCommand(payload, position, "TlIn", tally, (2 + _config.tallySources + 1) & ~1);	// Padded to an even length like the switcher does
+
+	const uint8_t streaming[4] = {highByte(_streamingStatus), lowByte(_streamingStatus), 0, 0};
+	return _appendCommand(payload, position, "StRS", streaming, sizeof(streaming));
+}
+
+/**
+ * Get the active session of the client with the given IP and Port, or NULL if there is none
+ */
+ATEMsimulator::Session *ATEMsimulator::_getSession(IPAddress ip, uint16_t port) {
+	for (uint16_t i = 0; i < _config.maxSessions; i++) {
+		if (_sessions[i]._active && _sessions[i]._ip == ip && _sessions[i]._port == port) return &_sessions[i];
+	}
+	return NULL;
+}
+
+/**
+ * Builds a header in _buffer, like TallyServer::_createHeader() does. Packages asking for an acknowledge get the next packet ID of the session.
+ */
+void ATEMsimulator::_createHeader(Session *session, uint8_t flags, uint16_t lengthOfData, uint16_t remotePacketID) {
+	_buffer[0] = flags | (highByte(lengthOfData) & 0b00000111);	// Flags + length
+	_buffer[1] = lowByte(lengthOfData);							// Length
+
+	_buffer[2] = highByte(session->_sessionId);	// Session ID
+	_buffer[3] = lowByte(session->_sessionId);	// Session ID
+
+	_buffer[4] = highByte(remotePacketID);		// Remote Packet ID
+	_buffer[5] = lowByte(remotePacketID);		// Remote Packet ID
+
+	if (flags & TALLY_SERVER_FLAG_ACK_REQUEST && !(flags & (TALLY_SERVER_FLAG_RESENT_PACKAGE | TALLY_SERVER_FLAG_RESEND_REQUEST | TALLY_SERVER_FLAG_HELLO))) {
+		session->_localPacketId = (session->_localPacketId + 1) & 0x7FFF;	// Wraps at bit 15 like the switcher
+
+		_buffer[10] = highByte(session->_localPacketId);	// Local Packet ID
+		_buffer[11] = lowByte(session->_localPacketId);		// Local Packet ID
+	}
+}
+
+/**
+ * Sends payload in a new package asking for an acknowledge, and keeps it for resend requests
+ */
+void ATEMsimulator::_sendPackage(Session *session, const uint8_t *payload, uint16_t payloadLength) {
+	uint16_t length = 12 + payloadLength;
+	memset(_buffer, 0, 12);
+	_createHeader(session, TALLY_SERVER_FLAG_ACK_REQUEST, length, 0);
+	memcpy(_buffer + 12, payload, payloadLength);
+
+	uint16_t slot = session->_localPacketId % _historyLength;
+	memcpy(session->_history + (size_t)slot * SIMULATOR_maxPacketLength, _buffer, length);
+	session->_historyPacketIds[slot] = session->_localPacketId;
+	session->_historyLengths[slot] = length;
+	session->_historySentAt[slot] = millis();
+	session->_historyRetransmits[slot] = 0;
+
+	_sendBuffer(session, _buffer, length);
+}
+
+/**
+ * Sends the package in slot of the history of session again, marked as resent
+ */
+void ATEMsimulator::_resendPackage(Session *session, uint16_t slot) {
+	uint16_t length = session->_historyLengths[slot];
+	memcpy(_buffer, session->_history + (size_t)slot * SIMULATOR_maxPacketLength, length);
+	_buffer[0] |= TALLY_SERVER_FLAG_RESENT_PACKAGE;
+	_sendBuffer(session, _buffer, length);
+}
+
+/**
+ * Takes the packages of session up to and including ackedId as acknowledged, as a switcher does
+ */
+void ATEMsimulator::_handleAck(Session *session, uint16_t ackedId) {
+	uint16_t sent = (session->_localPacketId - session->_unackedPacketId + 1) & 0x7FFF;	// Packages waiting for an acknowledge
+	if (sent == 0 || ((ackedId - session->_unackedPacketId) & 0x7FFF) >= sent) return;	// Nothing waiting, or not one of them
+
+	session->_unackedPacketId = (ackedId + 1) & 0x7FFF;
+}
+
+/**
+ * Sends the packages of session that haven't been acknowledged within SIMULATOR_retransmitTimeout again, like a switcher does.
+ * Without it a lost last package is never noticed by the client, as nothing comes after it. Above all the empty one ending the init dump.
+ */
+void ATEMsimulator::_retransmitPackages(Session *session) {
+	unsigned long now = millis();
+	if (now - session->_lastRetransmitCheck < SIMULATOR_retransmitTimeout / 4) return;
+	session->_lastRetransmitCheck = now;
+
+	uint16_t next = (session->_localPacketId + 1) & 0x7FFF;
+	bool oldest = true;		// Still moving _unackedPacketId past packages that are done with
+	for (uint16_t packetId = session->_unackedPacketId; packetId != next; packetId = (packetId + 1) & 0x7FFF) {
+		uint16_t slot = packetId % _historyLength;
+		bool done = session->_historyPacketIds[slot] != packetId || session->_historyLengths[slot] == 0 || session->_historyRetransmits[slot] >= SIMULATOR_maxRetransmits;
+		if (done) {
+			if (oldest) session->_unackedPacketId = (packetId + 1) & 0x7FFF;
+			continue;
+		}
+		oldest = false;
+
+		if (now - session->_historySentAt[slot] >= SIMULATOR_retransmitTimeout) {
+			_resendPackage(session, slot);
+			session->_historySentAt[slot] = now;
+			session->_historyRetransmits[slot]++;
+			_stats.retransmits++;
+		}
+	}
+}
+
+/**
+ * Sends length bytes of buffer to the client of session, unless it's picked to be lost
+ */
+void ATEMsimulator::_sendBuffer(Session *session, const uint8_t *buffer, uint16_t length) {
+	session->_lastSend = millis();
+	if (_config.lossPercent > 0 && random(100) < _config.lossPercent) {
+		_stats.datagramsDropped++;
+		return;
+	}
+
+	_udp->beginPacket(session->_ip, session->_port);
+	_udp->write(buffer, length);
+	_udp->endPacket();
+	_stats.datagramsOut++;
+}
+
+/**
+ * Reset given session, so that it's ready for a new client connecting
+ */
+void ATEMsimulator::_resetSession(Session *session) {
+	session->_active = false;
+	session->_initialized = false;
+	session->_sessionId = 0;
+	session->_localPacketId = 0;
+	session->_unackedPacketId = 1;
+	session->_lastRetransmitCheck = 0;
+	session->_lastRecv = 0;
+	session->_lastSend = 0;
+	memset(session->_historyLengths, 0, _historyLength * sizeof(uint16_t));
+}
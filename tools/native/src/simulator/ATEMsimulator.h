@@ -0,0 +1,135 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ATEMsimulator_h
+#define ATEMsimulator_h
+
+#include "Arduino.h"
+
+#include <UdpTransport.h>
+#include <TallyServer.h>	// Header flags and connection results, the framing is the same
+
+#define SIMULATOR_maxPacketLength 1400		// Largest datagram sent, also the largest init package
+#define SIMULATOR_historyMargin 64			// Packages kept for resend requests, on top of the init dump
+#define SIMULATOR_keepAliveInterval 250		// Time (ms) without sending to a session before it's sent an empty packet asking for an acknowledge
+#define SIMULATOR_retransmitTimeout 500		// Time (ms) a client has to acknowledge a package before it's sent again
+#define SIMULATOR_maxRetransmits 10			// Times a package is sent again before giving up on it
+#define SIMULATOR_maxTallySources 40
+
+/**
+ * What the simulated switcher does
+ */
+struct ATEMsimulatorConfig {
+	uint16_t maxSessions;		// Connection limit. Further clients are rejected like a fully booked switcher does
+	uint16_t initPackets;		// Number of packages in the dump of the switcher state a client gets when connecting
+	uint16_t initPacketSize;	// Size of each of those packages (bytes)
+	uint8_t tallySources;		// Number of sources in TlIn
+	uint16_t updateRate;		// Cuts per second, each sending PrgI, PrvI and TlIn (and now and then StRS) to all sessions. 0 for none
+	uint8_t lossPercent;		// Share of outgoing datagrams dropped on purpose
+	uint16_t sessionTimeout;	// Time (ms) without anything from a client before its session is dropped
+};
+
+struct ATEMsimulatorStats {
+	unsigned long datagramsIn;
+	unsigned long datagramsOut;
+	unsigned long datagramsDropped;		// By lossPercent
+	unsigned long malformed;			// Shorter than a header, or not the length the header says
+	unsigned long sessionsAccepted;
+	unsigned long sessionsRejected;
+	unsigned long sessionsTimedOut;
+	unsigned long initDumpsSent;
+	unsigned long updatesSent;			// Update packages, counted per session
+	unsigned long commandsReceived;		// Packages from clients with commands in them
+	unsigned long resendRequestsServed;
+	unsigned long resendRequestsMissed;	// Package no longer in the history
+	unsigned long retransmits;			// Packages sent again for not being acknowledged
+};
+
+/**
+ * The switcher side of the protocol ATEMbase talks, for load and latency testing without a switcher.
+ * Any number of sessions (up to maxSessions) are served from one socket, each with its own packet IDs and resend history.
+ */
+class ATEMsimulator {
+private:
+	struct Session {
+		IPAddress _ip;
+		uint16_t _port;
+		bool _active;
+		bool _initialized;				// Set when the init dump has been sent
+		uint16_t _sessionId;
+		uint16_t _localPacketId;
+		uint16_t _unackedPacketId;		// Oldest package not acknowledged or given up on yet
+		unsigned long _lastRetransmitCheck;
+		unsigned long _lastRecv;
+		unsigned long _lastSend;
+		uint8_t *_history;				// historyLength packages of SIMULATOR_maxPacketLength, indexed by packet ID
+		uint16_t *_historyPacketIds;
+		uint16_t *_historyLengths;
+		unsigned long *_historySentAt;
+		uint8_t *_historyRetransmits;
+	};
+
+	ATEMsimulatorConfig _config;
+	ATEMsimulatorStats _stats;
+
+	DefaultUdpTransport _defaultTransport;
+	UdpTransport *_udp;
+
+	Session *_sessions;
+	uint16_t _historyLength;
+	uint16_t _nextSessionId;
+
+	uint8_t _buffer[SIMULATOR_maxPacketLength];
+	uint8_t _payload[SIMULATOR_maxPacketLength];
+
+	uint8_t _programSource;
+	uint8_t _previewSource;
+	uint16_t _streamingStatus;
+	unsigned long _updates;
+	unsigned long _nextUpdateAt;	// micros()
+
+	Session *_getSession(IPAddress ip, uint16_t port);
+	void _handleDatagram(uint16_t length);
+	void _sendInitDump(Session *session);
+	void _sendUpdate();
+
+	uint16_t _appendCommand(uint8_t *payload, uint16_t position, const char *name, const uint8_t *data, uint16_t length);
+	uint16_t _appendState(uint8_t *payload, uint16_t position);
+
+	void _createHeader(Session *session, uint8_t flags, uint16_t lengthOfData, uint16_t remotePacketID);
+	void _sendPackage(Session *session, const uint8_t *payload, uint16_t payloadLength);
+	void _sendBuffer(Session *session, const uint8_t *buffer, uint16_t length);
+	void _resendPackage(Session *session, uint16_t slot);
+
+	void _handleAck(Session *session, uint16_t ackedId);
+	void _retransmitPackages(Session *session);
+
+	void _resetSession(Session *session);
+
+public:
+	ATEMsimulator(const ATEMsimulatorConfig &config);
+	~ATEMsimulator();
+	void setTransport(UdpTransport *transport);
+	bool begin(uint16_t port);
+	void end();
+	bool runLoop();
+
+	uint16_t getSessionCount();
+	const ATEMsimulatorStats &getStats();
+};
+
+#endif
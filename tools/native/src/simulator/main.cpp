@@ -0,0 +1,187 @@
+/*
+Copyright (C) 2026 Aron N. Het Lam, aronhetlam@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+Simulates an ATEM switcher (see ATEMsimulator.h) for tally lights and other ATEMbase clients, and optionally runs a number of ATEMmin clients
+against it in the same process over loopback. Prints statistics every second, and a summary when stopped.
+
+Usage: simulator [options]
+	--port <n>			UDP port to listen on (default 9910, which is what ATEMbase connects to)
+	--max-sessions <n>	Connection limit, further clients are rejected (default 8)
+	--init-packets <n>	Packages in the init dump (default 20)
+	--init-size <n>		Bytes per init package (default 1300)
+	--sources <n>		Tally sources (default 8)
+	--rate <n>			Cuts per second (default 10)
+	--loss <percent>	Share of outgoing datagrams to drop (default 0)
+	--timeout <ms>		Time without anything from a client before its session is dropped (default 2000)
+	--clients <n>		ATEMmin clients to run in this process against the simulator on 127.0.0.1 (default 0)
+	--duration <s>		Stop after this many seconds (default: run until interrupted)
+	--quiet				Only print the summary
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include <ATEMbase.h>
+#include <ATEMmin.h>
+#include "ATEMsimulator.h"
+
+#define CLIENT_basePort 52000	// Clients use ports from here, so none of them share a port
+
+static volatile bool running = true;
+
+static void stopRunning(int) {
+	running = false;
+}
+
+struct ClientStats {
+	uint16_t initialized;
+	uint16_t rejected;
+	unsigned long initMin;
+	unsigned long initMax;
+	unsigned long initSum;
+	unsigned long inits;
+	unsigned long tallyChanges;
+	unsigned long reconnects;
+	unsigned long initPackageRequests;
+};
+
+static void printSimulatorStats(ATEMsimulator &simulator, unsigned long seconds) {
+	const ATEMsimulatorStats &stats = simulator.getStats();
+	printf("[%lus] sessions %u, accepted %lu, rejected %lu, timed out %lu, init dumps %lu, updates %lu, resends %lu (missed %lu), retransmits %lu, in %lu, out %lu, dropped %lu\n",
+		seconds, simulator.getSessionCount(), stats.sessionsAccepted, stats.sessionsRejected, stats.sessionsTimedOut, stats.initDumpsSent,
+		stats.updatesSent, stats.resendRequestsServed, stats.resendRequestsMissed, stats.retransmits, stats.datagramsIn, stats.datagramsOut, stats.datagramsDropped);
+}
+
+static void printClientStats(const ClientStats &stats, uint16_t clients) {
+	printf("  clients initialized %u/%u, rejected %u, inits %lu (%lu/%lu/%lu ms min/avg/max), init packages asked for %lu, tally changes %lu, reconnects %lu\n",
+		stats.initialized, clients, stats.rejected, stats.inits, stats.inits > 0 ? stats.initMin : 0, stats.inits > 0 ? stats.initSum / stats.inits : 0,
+		stats.initMax, stats.initPackageRequests, stats.tallyChanges, stats.reconnects);
+}
+
+int main(int argc, char **argv) {
+	ATEMsimulatorConfig config = {8, 20, 1300, 8, 10, 0, 2000};
+	uint16_t port = 9910;
+	uint16_t clientCount = 0;
+	unsigned long duration = 0;
+	bool quiet = false;
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--quiet") == 0) quiet = true;
+		else if (strcmp(argv[i], "--port") == 0 && hasValue) port = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--max-sessions") == 0 && hasValue) config.maxSessions = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--init-packets") == 0 && hasValue) config.initPackets = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--init-size") == 0 && hasValue) config.initPacketSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--sources") == 0 && hasValue) config.tallySources = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--rate") == 0 && hasValue) config.updateRate = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--loss") == 0 && hasValue) config.lossPercent = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--timeout") == 0 && hasValue) config.sessionTimeout = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--clients") == 0 && hasValue) clientCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--duration") == 0 && hasValue) duration = strtoul(argv[++i], NULL, 10);
+		else {
+			fprintf(stderr, "Usage: %s [--port <n>] [--max-sessions <n>] [--init-packets <n>] [--init-size <n>] [--sources <n>] [--rate <n>] [--loss <percent>] [--timeout <ms>] [--clients <n>] [--duration <s>] [--quiet]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (clientCount > 0 && port != 9910) {
+		fprintf(stderr, "--clients needs --port 9910, as that's where ATEMbase connects to\n");
+		return 2;
+	}
+
+	signal(SIGINT, stopRunning);
+	signal(SIGTERM, stopRunning);
+	randomSeed(micros());
+
+	ATEMsimulator simulator(config);
+	if (!simulator.begin(port)) {
+		perror("Couldn't listen");
+		return 1;
+	}
+
+	ATEMmin *clients = new ATEMmin[clientCount];
+	bool *wasInitialized = new bool[clientCount];
+	uint8_t *lastProgramTally = new uint8_t[clientCount];
+	for (uint16_t i = 0; i < clientCount; i++) {
+		clients[i].begin(IPAddress(127, 0, 0, 1), CLIENT_basePort + i);
+		clients[i].connect(true);
+		wasInitialized[i] = false;
+		lastProgramTally[i] = 0;
+	}
+	ClientStats clientStats;
+	memset(&clientStats, 0, sizeof(clientStats));
+	clientStats.initMin = (unsigned long)-1;
+
+	unsigned long startedAt = millis();
+	unsigned long lastPrintAt = startedAt;
+	while (running && (duration == 0 || millis() - startedAt < duration * 1000)) {
+		bool busy = simulator.runLoop();
+
+		clientStats.initialized = 0;
+		clientStats.rejected = 0;
+		clientStats.reconnects = 0;
+		clientStats.initPackageRequests = 0;
+		for (uint16_t i = 0; i < clientCount; i++) {
+			ATEMmin &client = clients[i];
+			busy |= client.runLoopBounded(0, 0).packetsProcessed > 0;
+
+			if (client.hasInitialized() && !wasInitialized[i]) {
+				unsigned long initDuration = client.getInitDuration();
+				clientStats.inits++;
+				clientStats.initSum += initDuration;
+				clientStats.initMin = min(clientStats.initMin, initDuration);
+				clientStats.initMax = max(clientStats.initMax, initDuration);
+			}
+			wasInitialized[i] = client.hasInitialized();
+			if (wasInitialized[i]) clientStats.initialized++;
+			if (client.isRejected()) clientStats.rejected++;
+			clientStats.reconnects += client.getReconnectCount();
+			clientStats.initPackageRequests += client.getInitPackageRequestCount();
+
+			uint8_t programTally = 0;	// Source on program, as seen in TlIn
+			for (uint8_t s = 0; s < client.getTallyByIndexSources(); s++) {
+				if (client.getTallyByIndexTallyFlags(s) & 1) programTally = s + 1;
+			}
+			if (programTally != lastProgramTally[i]) {
+				clientStats.tallyChanges++;
+				lastProgramTally[i] = programTally;
+			}
+		}
+
+		if (millis() - lastPrintAt >= 1000) {
+			lastPrintAt += 1000;
+			if (!quiet) {
+				printSimulatorStats(simulator, (lastPrintAt - startedAt) / 1000);
+				if (clientCount > 0) printClientStats(clientStats, clientCount);
+				fflush(stdout);
+			}
+		}
+
+		if (!busy) delay(1);
+	}
+
+	printf("Summary after %.1f s:\n", (millis() - startedAt) / 1000.0);
+	printSimulatorStats(simulator, (millis() - startedAt) / 1000);
+	if (clientCount > 0) printClientStats(clientStats, clientCount);
+
+	simulator.end();
+	delete[] clients;
+	delete[] wasInitialized;
+	delete[] lastProgramTally;
+	return 0;
+}